@@ -1,152 +1,871 @@
-
 /*
  * Copyright (C) Jianyong Chen
  */
 
-#include <vector>
-#include <hash.hh>
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+#include <bloom_filter.hh>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BLOOM_HAVE_AVX2  1
+#include <immintrin.h>
+#else
+#define BLOOM_HAVE_AVX2  0
+#endif
+
+
+/* 批量查询时每一批 key 的个数 */
+static const size_t  kBatchSize = 64;
+
+/* 并行构建时每个线程至少处理的 key 的个数 */
+static const size_t  kKeysPerThread = 1 << 16;
 
 
-static uint32_t BloomHash(const std::string &key) {
-    return Hash(key, 0xbc9f1d34);
+BloomFilter::BloomFilter(int bits_per_key, Layout layout, HashWidth hash_width)
+    : bits_per_key_(bits_per_key), layout_(layout), reduction_(kPowerOfTwo),
+      hash_width_(hash_width), fixed_(false), num_keys_(0),
+      prefix_delimiter_(0), prefix_depth_(0), map_data_(NULL), map_size_(0)
+{
+    // k_ 表示要进行 hash 的次数
+    k_ = BloomNumProbes(bits_per_key);
+
+    // 初始化 key 集合大小为 64
+    keys_.reserve(64);
 }
 
 
-class BloomFilter {
-    private:
-        size_t bits_per_key_;
-        size_t k_;
-        std::string bitmap_;
-        std::vector<std::string> *keys_;
+BloomFilter::BloomFilter(size_t expected_keys, double fp_rate, Layout layout,
+    Reduction reduction, HashWidth hash_width)
+    : layout_(layout), reduction_(reduction), hash_width_(hash_width),
+      fixed_(true), num_keys_(0), prefix_delimiter_(0), prefix_depth_(0),
+      map_data_(NULL), map_size_(0)
+{
+    assert(fp_rate > 0 && fp_rate < 1);
 
+    // 分块布局的误判率会略高一些
+    const double  bits_per_key = BloomBitsPerKey(fp_rate);
+    const size_t  align = (layout == kBlocked) ? kCacheLineSize : 8;
+    size_t        bytes;
 
-        void Resize() {
-            // 位图扩大一倍
-            const size_t  new_size = bitmap_.size() << 1;
-            std::string  new_bitmap = std::string(new_size, 0);
-            bitmap_ = new_bitmap;
+    bits_per_key_ = static_cast<size_t>(ceil(bits_per_key));
+    k_ = BloomNumProbes(bits_per_key);
 
-            for (const auto &key : *keys_) {
-                _AddKey(key);
-            }
+    bytes = static_cast<size_t>(
+                ceil(std::max<size_t>(expected_keys, 1) * bits_per_key / 8));
+    bytes = (bytes + align - 1) / align * align;
+
+    if (reduction == kPowerOfTwo) {
+        // 最多多用一倍内存，误判率也相应降低
+        size_t  pow2 = align;
+
+        while (pow2 < bytes) {
+            pow2 <<= 1;
         }
 
+        bytes = pow2;
+    }
 
-        void _AddKey(const std::string &key) {
-            const size_t  bits = bitmap_.size() * 8;
-            char  *array = &bitmap_[0];
-            uint32_t  h = BloomHash(key);
-            const uint32_t  delta = (h >> 17) | (h << 15);
+    bitmap_.resize(bytes, 0);
+}
 
-            for (int i = 0; i < k_; i++) {
-                const uint32_t  bitpos = h % bits;
-                array[bitpos/8] |= (1 << (bitpos % 8));
-                h += delta;
-            }
+
+void
+BloomFilter::Resize()
+{
+    // 位图扩大一倍
+    const size_t  new_size = bitmap_.size() << 1;
+    Bitmap  new_bitmap = Bitmap(new_size, 0);
+    bitmap_ = new_bitmap;
+
+    for (const auto &key : keys_) {
+        SetKey<false>(key);
+    }
+
+    for (const auto h : hashes_) {
+        SetBits<false>(h);
+    }
+}
+
+
+/*
+ * 动态大小的过滤器在添加一个 key 之前调用，随着 key 的添加误判率会变高，
+ * 所以需要及时扩大位图
+ */
+void
+BloomFilter::Reserve()
+{
+    if (bitmap_.empty()) {
+        // 将位图的初始大小设置为 8 * 8 bits，分块布局至少要有一个块
+        bitmap_.resize(layout_ == kBlocked ? kCacheLineSize : 8, 0);
+    }
+
+    if (bitmap_.size() * 8 <= (keys_.size() + hashes_.size()) * bits_per_key_) {
+        Resize();
+    }
+}
+
+
+template <bool kAtomic>
+static inline void
+SetBit(char *array, size_t bitpos)
+{
+    const char  mask = static_cast<char>(1 << (bitpos % 8));
+
+    if (kAtomic) {
+        // 多个线程同时构建时，同一个字节可能被不同线程修改
+        __atomic_fetch_or(&array[bitpos/8], mask, __ATOMIC_RELAXED);
+
+    } else {
+        array[bitpos/8] |= mask;
+    }
+}
+
+
+template <typename H>
+size_t
+BloomFilter::Reduce(H h, size_t n) const
+{
+    switch (reduction_) {
+
+    case kPowerOfTwo:
+        return BloomReduce<kPowerOfTwo>(h, n);
+
+    case kFastRange:
+        return BloomReduce<kFastRange>(h, n);
+
+    default:
+        return BloomReduce<kModulo>(h, n);
+    }
+}
+
+
+template <bool kAtomic, BloomFilter::Reduction R, typename H>
+void
+BloomFilter::SetBitsImpl(H h)
+{
+    char  *array = &bitmap_[0];
+
+    BloomProbe<R>(h, k_, layout_ == kBlocked, bitmap_.size() * 8,
+                  [array](size_t bitpos) {
+                      SetBit<kAtomic>(array, bitpos);
+                      return true;
+                  });
+}
+
+
+/*
+ * 每次添加只判断一次映射方式，探测的循环按映射方式分别生成
+ */
+template <bool kAtomic, typename H>
+void
+BloomFilter::SetBits(H h)
+{
+    switch (reduction_) {
+
+    case kPowerOfTwo:
+        SetBitsImpl<kAtomic, kPowerOfTwo>(h);
+        break;
+
+    case kFastRange:
+        SetBitsImpl<kAtomic, kFastRange>(h);
+        break;
+
+    default:
+        SetBitsImpl<kAtomic, kModulo>(h);
+        break;
+    }
+}
+
+
+template <bool kAtomic>
+void
+BloomFilter::SetKey(const Slice &key)
+{
+    if (hash_width_ == kHash64) {
+        SetBits<kAtomic>(BloomHash64(key));
+
+    } else {
+        SetBits<kAtomic>(BloomHash(key));
+    }
+
+    // 第 depth 级的前缀，由短到长
+    for (size_t depth = 1; depth <= prefix_depth_; depth++) {
+        const size_t  len = PrefixLength(key, depth);
+
+        if (len == 0) {
+            break;
         }
 
+        const Slice  prefix(key.data(), len);
 
-    public:
-        explicit BloomFilter(int bits_per_key)
-            : bits_per_key_(bits_per_key) {
-            // k_ 表示要进行 hash 的次数
-            // 研究表明 k = bits_per_key * ln(2) 时误判率低
-            k_ = static_cast<size_t>(bits_per_key * 0.69);
+        if (hash_width_ == kHash64) {
+            SetBits<kAtomic>(Hash64(prefix, kBloomPrefixSeed));
 
-            if (k_ < 1) {
-                k_ = 1;
-            }
-            if (k_ > 30) {
-                k_ = 30;
+        } else {
+            SetBits<kAtomic>(Hash(prefix, kBloomPrefixSeed));
+        }
+    }
+}
+
+
+size_t
+BloomFilter::PrefixLength(const Slice &key, size_t depth) const
+{
+    const char  *p = key.data();
+    const char  *end = key.data() + key.size();
+
+    for (size_t i = 0; i < depth; i++) {
+        p = static_cast<const char *>(memchr(p, prefix_delimiter_, end - p));
+        if (p == NULL) {
+            return 0;
+        }
+
+        p++;
+    }
+
+    return p - key.data();
+}
+
+
+void
+BloomFilter::SetPrefixPolicy(char delimiter, size_t depth)
+{
+    assert(!ReadOnly() && num_keys_ == 0);
+
+    // 文件头中只有一个字节
+    prefix_delimiter_ = delimiter;
+    prefix_depth_ = std::min<size_t>(depth, 255);
+}
+
+
+void
+BloomFilter::AddHash(uint32_t h)
+{
+    assert(!ReadOnly() && hash_width_ == kHash32);
+
+    num_keys_++;
+
+    if (fixed_) {
+        SetBits<false>(h);
+        return;
+    }
+
+    Reserve();
+    SetBits<false>(h);
+
+    hashes_.push_back(h);
+}
+
+
+void
+BloomFilter::AddHash64(uint64_t h)
+{
+    assert(!ReadOnly() && hash_width_ == kHash64 && fixed_);
+
+    num_keys_++;
+    SetBits<false>(h);
+}
+
+
+void
+BloomFilter::AddKeysParallel(const std::vector<std::string> &keys,
+    size_t nthreads)
+{
+    size_t                    i, chunk;
+    std::vector<std::thread>  workers;
+
+    if (nthreads == 0) {
+        nthreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // key 太少时创建线程得不偿失
+    nthreads = std::min(nthreads,
+                        std::max<size_t>(1, keys.size() / kKeysPerThread));
+
+    if (nthreads == 1) {
+        for (const auto &key : keys) {
+            SetKey<false>(key);
+        }
+
+        return;
+    }
+
+    chunk = (keys.size() + nthreads - 1) / nthreads;
+
+    for (i = 0; i < keys.size(); i += chunk) {
+        const size_t  begin = i;
+        const size_t  end = std::min(i + chunk, keys.size());
+
+        workers.emplace_back([this, &keys, begin, end]() {
+            for (size_t j = begin; j < end; j++) {
+                SetKey<true>(keys[j]);
             }
+        });
+    }
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+
+void
+BloomFilter::Build(const std::vector<std::string> &keys, size_t nthreads)
+{
+    assert(!ReadOnly());
+
+    if (keys.empty()) {
+        return;
+    }
+
+    num_keys_ += keys.size();
+
+    if (fixed_) {
+        AddKeysParallel(keys, nthreads);
+        return;
+    }
+
+    /*
+     * 直接算出逐个 AddKey 之后位图最终的大小，只分配一次、
+     * 只对已有的 key 重新 hash 一次
+     */
+    size_t  bytes = bitmap_.size();
+    const size_t  limit = (keys_.size() + hashes_.size() + keys.size() - 1)
+                          * bits_per_key_;
+
+    if (bytes == 0) {
+        bytes = (layout_ == kBlocked) ? kCacheLineSize : 8;
+    }
+
+    while (bytes * 8 <= limit) {
+        bytes <<= 1;
+    }
+
+    if (bytes != bitmap_.size()) {
+        bitmap_.assign(bytes, 0);
+        AddKeysParallel(keys_, nthreads);
 
-            // 初始化 key 集合大小为 64
-            keys_ = new std::vector<std::string>;
-            keys_->reserve(64);
+        for (const auto h : hashes_) {
+            SetBits<false>(h);
         }
+    }
+
+    AddKeysParallel(keys, nthreads);
+
+    keys_.insert(keys_.end(), keys.begin(), keys.end());
+}
+
+
+void
+BloomFilter::AddKey(const Slice &key)
+{
+    assert(!ReadOnly());
+
+    num_keys_++;
+
+    if (fixed_) {
+        // 位图大小在构造时已经确定，不需要保存 key
+        SetKey<false>(key);
+        return;
+    }
+
+    Reserve();
+    SetKey<false>(key);
 
+    keys_.emplace_back(key.data(), key.size());
+}
 
-        void AddKey(const std::string &key) {
-            if (bitmap_.empty()) {
-                // 将位图的初始大小设置为 8 * 8 bits
-                bitmap_.resize(8, 0);
+
+size_t
+BloomFilter::ApproximateMemoryUsage() const
+{
+    size_t  usage = sizeof(*this) + bitmap_.capacity()
+                    + keys_.capacity() * sizeof(std::string)
+                    + hashes_.capacity() * sizeof(uint32_t);
+
+    for (const auto &key : keys_) {
+        // 短字符串直接存放在 std::string 对象内部
+        if (key.capacity() > sizeof(std::string) - 1) {
+            usage += key.capacity() + 1;
+        }
+    }
+
+    return usage;
+}
+
+
+bool
+BloomFilter::KeyMayMatch(const Slice &key) const
+{
+    if (hash_width_ == kHash64) {
+        return Probe(BloomHash64(key));
+    }
+
+    return Probe(BloomHash(key));
+}
+
+
+bool
+BloomFilter::ProbePrefix(const Slice &prefix) const
+{
+    if (hash_width_ == kHash64) {
+        return Probe(Hash64(prefix, kBloomPrefixSeed));
+    }
+
+    return Probe(Hash(prefix, kBloomPrefixSeed));
+}
+
+
+bool
+BloomFilter::PrefixMayMatch(const Slice &prefix) const
+{
+    size_t  depth, len, longest = 0;
+
+    if (Size() == 0) {
+        return false;
+    }
+
+    for (depth = 1; depth <= prefix_depth_; depth++) {
+        len = PrefixLength(prefix, depth);
+        if (len == 0) {
+            break;
+        }
+
+        longest = len;
+    }
+
+    if (longest == 0) {
+        return true;
+    }
+
+    return ProbePrefix(Slice(prefix.data(), longest));
+}
+
+
+bool
+BloomFilter::RangeMayMatch(const Slice &start, const Slice &end) const
+{
+    const size_t  n = std::min(start.size(), end.size());
+    size_t        i = 0;
+
+    while (i < n && start[i] == end[i]) {
+        i++;
+    }
+
+    return PrefixMayMatch(Slice(start.data(), i));
+}
+
+
+bool
+BloomFilter::HashMayMatch(uint32_t h) const
+{
+    assert(hash_width_ == kHash32);
+
+    return Probe(h);
+}
+
+
+bool
+BloomFilter::HashMayMatch64(uint64_t h) const
+{
+    assert(hash_width_ == kHash64);
+
+    return Probe(h);
+}
+
+
+template <typename H>
+bool
+BloomFilter::Probe(H h) const
+{
+    if (Size() == 0) {
+        return false;
+    }
+
+    switch (reduction_) {
+
+    case kPowerOfTwo:
+        return ProbeImpl<kPowerOfTwo>(h);
+
+    case kFastRange:
+        return ProbeImpl<kFastRange>(h);
+
+    default:
+        return ProbeImpl<kModulo>(h);
+    }
+}
+
+
+template <BloomFilter::Reduction R, typename H>
+bool
+BloomFilter::ProbeImpl(H h) const
+{
+    const char  *array = Data();
+
+    if (k_ > 30) {
+        return true;
+    }
+
+    /*
+     * 只要有一个位置不为 1，就说明 key 不在集合中；分块布局下
+     * 所有探测位都在同一个 cache line 内，最多只有一次 cache miss
+     */
+    return BloomProbe<R>(h, k_, layout_ == kBlocked, Size() * 8,
+                         [array](size_t bitpos) {
+                             return (array[bitpos/8] & (1 << (bitpos%8))) != 0;
+                         });
+}
+
+
+#if BLOOM_HAVE_AVX2
+
+/*
+ * 8 个 32 位的 h 同时映射到 [0, n)，n 必须小于 2^32
+ * fastrange 为 false 时 n 必须是 2 的幂
+ */
+__attribute__((target("avx2")))
+static inline __m256i
+ReduceAvx2(__m256i h, __m256i n, bool fastrange)
+{
+    if (!fastrange) {
+        return _mm256_and_si256(h, _mm256_sub_epi32(n, _mm256_set1_epi32(1)));
+    }
+
+    /*
+     * _mm256_mul_epu32 只乘每个 64 位中的低 32 位，
+     * 奇数位置的 h 要先移下来，乘积的高 32 位就是结果
+     */
+    const __m256i  even = _mm256_srli_epi64(_mm256_mul_epu32(h, n), 32);
+    const __m256i  odd = _mm256_mul_epu32(_mm256_srli_epi64(h, 32), n);
+
+    return _mm256_blend_epi32(even, odd, 0xaa);
+}
+
+
+/*
+ * 每次用 gather 指令同时探测 8 个 key
+ *
+ * 位图按小端序解释为 32 位整数数组，第 bitpos 位正好是
+ * 第 bitpos/32 个整数的第 bitpos%32 位
+ *
+ * 返回已经处理的 key 的个数，剩下不足 8 个的由调用者处理
+ */
+__attribute__((target("avx2")))
+static size_t
+ProbeBatchAvx2(const char *array, size_t len, size_t k, bool blocked,
+    bool fastrange, const uint32_t *hashes, size_t n, bool *match)
+{
+    size_t         i, j, l;
+    int            alive_bits;
+    const int     *words = reinterpret_cast<const int *>(array);
+    const __m256i  zero = _mm256_setzero_si256();
+    const __m256i  one = _mm256_set1_epi32(1);
+    const __m256i  low5 = _mm256_set1_epi32(31);
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m256i  h = _mm256_loadu_si256(
+                         reinterpret_cast<const __m256i *>(hashes + i));
+        __m256i  delta = _mm256_or_si256(_mm256_srli_epi32(h, 17),
+                                         _mm256_slli_epi32(h, 15));
+        __m256i  alive = _mm256_set1_epi32(-1);
+        __m256i  bitpos, idx, word, bit, miss;
+
+        if (blocked) {
+            const __m256i  nblocks =
+                _mm256_set1_epi32(static_cast<int>(len / kCacheLineSize));
+            const __m256i  golden = _mm256_set1_epi32(0x9e3779b9);
+
+            /* 每个块有 16 个 32 位整数 */
+            __m256i  base = _mm256_slli_epi32(ReduceAvx2(h, nblocks, fastrange),
+                                              4);
+            __m256i  h2 = delta;
+
+            for (j = 0; j < k; j++) {
+                h2 = _mm256_mullo_epi32(h2, golden);
+                bitpos = _mm256_srli_epi32(h2, 23);
+                idx = _mm256_add_epi32(base, _mm256_srli_epi32(bitpos, 5));
+                word = _mm256_i32gather_epi32(words, idx, 4);
+                bit = _mm256_sllv_epi32(one, _mm256_and_si256(bitpos, low5));
+                miss = _mm256_cmpeq_epi32(_mm256_and_si256(word, bit), zero);
+                alive = _mm256_andnot_si256(miss, alive);
+
+                if (_mm256_testz_si256(alive, alive)) {
+                    break;
+                }
             }
 
-            /*
-             * 随着 key 的添加，误判率会变高，所以需要及时扩大位图
-             */
-            if (bitmap_.size() * 8 <= keys_->size() * bits_per_key_) {
-                Resize();
+        } else {
+            const __m256i  bits =
+                _mm256_set1_epi32(static_cast<int>(len * 8));
+
+            for (j = 0; j < k; j++) {
+                bitpos = ReduceAvx2(h, bits, fastrange);
+                idx = _mm256_srli_epi32(bitpos, 5);
+                word = _mm256_i32gather_epi32(words, idx, 4);
+                bit = _mm256_sllv_epi32(one, _mm256_and_si256(bitpos, low5));
+                miss = _mm256_cmpeq_epi32(_mm256_and_si256(word, bit), zero);
+                alive = _mm256_andnot_si256(miss, alive);
+
+                if (_mm256_testz_si256(alive, alive)) {
+                    break;
+                }
+
+                h = _mm256_add_epi32(h, delta);
             }
+        }
 
-            _AddKey(key);
+        alive_bits = _mm256_movemask_ps(_mm256_castsi256_ps(alive));
 
-            keys_->push_back(key);
+        for (l = 0; l < 8; l++) {
+            match[i + l] = (alive_bits >> l) & 1;
         }
+    }
 
+    return i;
+}
 
 
-        bool KeyMayMatch(const std::string &key) const {
-            if (bitmap_.empty()) {
-                return false;
+static bool
+CpuHasAvx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif /* BLOOM_HAVE_AVX2 */
+
+
+void
+BloomFilter::KeyMayMatchBatch(const std::vector<std::string> &keys,
+    std::vector<bool> &result) const
+{
+    KeyMayMatchBatchImpl(keys, result);
+}
+
+
+void
+BloomFilter::KeyMayMatchBatch(const std::vector<Slice> &keys,
+    std::vector<bool> &result) const
+{
+    KeyMayMatchBatchImpl(keys, result);
+}
+
+
+template <typename Key>
+void
+BloomFilter::KeyMayMatchBatchImpl(const std::vector<Key> &keys,
+    std::vector<bool> &result) const
+{
+    size_t    i, j, n, done;
+    uint32_t  hashes[kBatchSize];
+    uint64_t  hashes64[kBatchSize];
+    bool      match[kBatchSize];
+
+    result.assign(keys.size(), false);
+
+    if (Size() == 0) {
+        return;
+    }
+
+    const size_t len = Size();
+    const char *array = Data();
+    const size_t nblocks = len / kCacheLineSize;
+
+    // 预取第一次探测所在的 cache line
+    auto prefetch = [&](auto h) {
+        if (layout_ == kBlocked) {
+            __builtin_prefetch(array + Reduce(h, nblocks) * kCacheLineSize);
+
+        } else {
+            __builtin_prefetch(array + Reduce(h, len * 8) / 8);
+        }
+    };
+
+#if BLOOM_HAVE_AVX2
+    static const bool  has_avx2 = CpuHasAvx2();
+
+    /*
+     * 向量化的映射要求位数(或块数)能放进 32 位，
+     * 取模只有在位图大小是 2 的幂时才能换成按位与，
+     * gather 的下标是有符号 32 位整数
+     */
+    const bool pow2 = (len & (len - 1)) == 0;
+    const bool fastrange = (reduction_ == kFastRange);
+    const bool use_avx2 = has_avx2 && k_ <= 30 && hash_width_ == kHash32
+                          && len * 8 <= UINT32_MAX
+                          && (fastrange || pow2);
+#endif
+
+    for (i = 0; i < keys.size(); i += kBatchSize) {
+        n = std::min(kBatchSize, keys.size() - i);
+
+        /*
+         * 先算出这一批所有 key 的 hash 并预取，这样多个 cache miss
+         * 可以同时进行
+         */
+        if (hash_width_ == kHash64) {
+            for (j = 0; j < n; j++) {
+                hashes64[j] = BloomHash64(keys[i + j]);
+                prefetch(hashes64[j]);
+            }
+
+            for (j = 0; j < n; j++) {
+                match[j] = Probe(hashes64[j]);
             }
 
-            const size_t len = bitmap_.size();
-            const char *array = bitmap_.data();
-            const size_t bits = len * 8;
+        } else {
+            // 32 位的 hash 每轮只有 4 个字节，交替计算的收益更明显
+            HashBatch(&keys[i], n, kBloomHashSeed, hashes);
 
-            if (k_ > 30) {
-                return true;
+            for (j = 0; j < n; j++) {
+                prefetch(hashes[j]);
             }
 
-            uint32_t h = BloomHash(key);
-            const uint32_t delta = (h >> 17) | (h << 15);
-            for (size_t j = 0; j < k_; j++) {
-                // 依次计算每一轮的 hash
-                // 只有有一个位置不为 1，就说明 key 不在集合中
-                const uint32_t bitpos = h % bits;
-                if ((array[bitpos/8] & (1 << (bitpos%8))) == 0) {
-                    return false;
-                }
-                h+= delta;
+            done = 0;
+
+#if BLOOM_HAVE_AVX2
+            if (use_avx2) {
+                done = ProbeBatchAvx2(array, len, k_, layout_ == kBlocked,
+                                      fastrange, hashes, n, match);
             }
+#endif
 
-            return true;
+            for (j = done; j < n; j++) {
+                match[j] = Probe(hashes[j]);
+            }
         }
-};
 
+        for (j = 0; j < n; j++) {
+            result[i + j] = match[j];
+        }
+    }
+}
 
-int
-main(int argc, char **argv)
+
+#if BLOOM_HAVE_AVX2
+
+/*
+ * 每轮处理 128 字节，即两个 cache line，返回已经处理的字节数，
+ * 剩下的由调用者处理
+ */
+__attribute__((target("avx2")))
+static size_t
+MergeBitmapAvx2(char *dst, const char *src, size_t len, bool intersect)
+{
+    size_t  i, j;
+
+    for (i = 0; i + 128 <= len; i += 128) {
+        __m256i  *d = reinterpret_cast<__m256i *>(dst + i);
+        const __m256i  *s = reinterpret_cast<const __m256i *>(src + i);
+
+        for (j = 0; j < 4; j++) {
+            const __m256i  a = _mm256_loadu_si256(d + j);
+            const __m256i  b = _mm256_loadu_si256(s + j);
+
+            _mm256_storeu_si256(d + j, intersect ? _mm256_and_si256(a, b)
+                                                 : _mm256_or_si256(a, b));
+        }
+    }
+
+    return i;
+}
+
+#endif /* BLOOM_HAVE_AVX2 */
+
+
+/*
+ * 位图的大小总是 8 字节的倍数，按 64 位整数处理，编译器也会用 SSE2 向量化
+ */
+static void
+MergeBitmap(char *dst, const char *src, size_t len, bool intersect)
 {
-    bool         exist;
-    std::string  bitmap;
-    BloomFilter  bloom_filter(3);
+    size_t    i = 0;
+    uint64_t  a, b;
+
+#if BLOOM_HAVE_AVX2
+    static const bool  has_avx2 = CpuHasAvx2();
 
-    std::vector<std::string> keys =
-        { "abc", "leveldb", "moon", "funny", "lucy", "tommy",
-          "rimbaud", "tom", "pikazza", "chythia", "kolo", "meetyou" };
-    std::vector<std::string> keys2 =
-        { "hello", "world", "who", "programming language pragmatics",
-          "jerry", "sam", "nice", "whoami", "locate", "network", "iamyou" };
+    if (has_avx2) {
+        i = MergeBitmapAvx2(dst, src, len, intersect);
+    }
+#endif
 
+    for (/* void */; i < len; i += 8) {
+        memcpy(&a, dst + i, 8);
+        memcpy(&b, src + i, 8);
+        a = intersect ? (a & b) : (a | b);
+        memcpy(dst + i, &a, 8);
+    }
+}
 
-    for (int i = 0; i < keys.size(); i++) {
-        bloom_filter.AddKey(keys[i]);
+
+bool
+BloomFilter::Compatible(const BloomFilter &other) const
+{
+    return Size() == other.Size() && k_ == other.k_
+           && layout_ == other.layout_ && reduction_ == other.reduction_
+           && hash_width_ == other.hash_width_
+           && prefix_depth_ == other.prefix_depth_
+           && prefix_delimiter_ == other.prefix_delimiter_;
+}
+
+
+bool
+BloomFilter::Merge(const BloomFilter &other, bool intersect)
+{
+    if (ReadOnly()) {
+        errno = EROFS;
+        return false;
     }
 
+    if (!Compatible(other)) {
+        errno = EINVAL;
+        return false;
+    }
 
-    for (int i = 0; i < keys.size(); i++) {
-        exist = bloom_filter.KeyMayMatch(keys[i]);
-        printf("exist(%s): %d\n", keys[i].c_str(), exist);
+    if (&other == this || Size() == 0) {
+        return true;
     }
 
-    printf("\n");
+    MergeBitmap(&bitmap_[0], other.Data(), Size(), intersect);
 
-    for (int i = 0; i < keys2.size(); i++) {
-        exist = bloom_filter.KeyMayMatch(keys2[i]);
-        printf("exist(%s): %d\n", keys2[i].c_str(), exist);
+    if (!intersect && !fixed_ && !other.fixed_ && !other.ReadOnly()) {
+        // 两边的 key 都在，以后仍然可以扩大位图
+        keys_.insert(keys_.end(), other.keys_.begin(), other.keys_.end());
+        hashes_.insert(hashes_.end(), other.hashes_.begin(),
+                       other.hashes_.end());
+        num_keys_ += other.num_keys_;
+        return true;
     }
 
-    return 0;
+    /*
+     * 缺少另一边的 key(或者交集的 key 未知)，无法再重新 hash，
+     * key 的个数只是一个上界
+     */
+    num_keys_ = intersect ? std::min(num_keys_, other.num_keys_)
+                          : num_keys_ + other.num_keys_;
+    fixed_ = true;
+    std::vector<std::string>().swap(keys_);
+    std::vector<uint32_t>().swap(hashes_);
+
+    return true;
+}
+
+
+bool
+BloomFilter::Union(const BloomFilter &other)
+{
+    return Merge(other, false);
+}
+
+
+bool
+BloomFilter::Intersect(const BloomFilter &other)
+{
+    return Merge(other, true);
 }
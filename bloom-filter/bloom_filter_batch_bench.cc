@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <bloom_filter.hh>
+#include <bench_timer.hh>
+
+
+static void bench_batch(BloomFilter::Layout layout,
+    const std::vector<std::string> &keys,
+    const std::vector<std::string> &queries);
+
+
+/*
+ * 比较逐个调用 KeyMayMatch 与 KeyMayMatchBatch 的吞吐
+ *
+ * usage: bloom_filter_batch_bench [#keys]
+ */
+int
+main(int argc, char **argv)
+{
+    size_t                    n, i;
+    std::vector<std::string>  keys, queries;
+
+    n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 4000000;
+
+    keys.reserve(n);
+    queries.reserve(n);
+
+    for (i = 0; i < n; i++) {
+        keys.push_back("key-" + std::to_string(i));
+
+        /* 一半存在，一半不存在 */
+        if (i % 2) {
+            queries.push_back("key-" + std::to_string((i * 7919) % n));
+
+        } else {
+            queries.push_back("absent-" + std::to_string(i));
+        }
+    }
+
+    printf("%-9s %12s %12s %9s\n", "layout", "scalar-ns", "batch-ns",
+           "speedup");
+
+    bench_batch(BloomFilter::kStandard, keys, queries);
+    bench_batch(BloomFilter::kBlocked, keys, queries);
+
+    return 0;
+}
+
+
+static void
+bench_batch(BloomFilter::Layout layout, const std::vector<std::string> &keys,
+    const std::vector<std::string> &queries)
+{
+    size_t             i;
+    double             scalar_ns, batch_ns;
+    std::vector<bool>  expect, result;
+    BloomFilter        filter(10, layout);
+
+    for (i = 0; i < keys.size(); i++) {
+        filter.AddKey(keys[i]);
+    }
+
+    expect.resize(queries.size());
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (i = 0; i < queries.size(); i++) {
+        expect[i] = filter.KeyMayMatch(queries[i]);
+    }
+
+    scalar_ns = elapsed_ns(start) / queries.size();
+
+    start = std::chrono::steady_clock::now();
+
+    filter.KeyMayMatchBatch(queries, result);
+
+    batch_ns = elapsed_ns(start) / queries.size();
+
+    if (result != expect) {
+        fprintf(stderr, "KeyMayMatchBatch() disagrees with KeyMayMatch()\n");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%-9s %12.1f %12.1f %8.2fx\n",
+           layout == BloomFilter::kBlocked ? "blocked" : "standard",
+           scalar_ns, batch_ns, scalar_ns / batch_ns);
+}
@@ -0,0 +1,429 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <bloom_filter.hh>
+#include <bench_timer.hh>
+
+
+/* 统计延迟分布时采样的查询次数 */
+static const size_t  kLatencySamples = 1 << 20;
+
+/* 统计误判率时最多查询的不存在的 key 的个数 */
+static const size_t  kMaxFprQueries = 10000000;
+
+/* 插入时每次生成的 key 的个数，key 不需要全部放在内存中 */
+static const size_t  kKeyChunk = 1 << 20;
+
+
+struct Config {
+    const char              *name;
+    BloomFilter::Layout      layout;
+    BloomFilter::HashWidth   hash_width;
+};
+
+
+static const Config  kConfigs[] = {
+    { "standard/32", BloomFilter::kStandard, BloomFilter::kHash32 },
+    { "standard/64", BloomFilter::kStandard, BloomFilter::kHash64 },
+    { "blocked/32",  BloomFilter::kBlocked,  BloomFilter::kHash32 },
+    { "blocked/64",  BloomFilter::kBlocked,  BloomFilter::kHash64 },
+};
+
+
+static void bench_fpr(size_t n);
+static void bench_scale(size_t n, const Config &config);
+static void bench_reduction(size_t n);
+static void bench_prefix(size_t n);
+static void make_keys(const char *prefix, size_t begin, size_t end,
+    size_t stride, std::vector<std::string> &keys);
+static void add_keys(BloomFilter &filter, size_t n);
+static size_t count_false_positives(const BloomFilter &filter, size_t n);
+static void lookup_latency(const BloomFilter &filter,
+    const std::vector<std::string> &keys, std::vector<double> &latency);
+static double percentile(const std::vector<double> &sorted, double p);
+static double timer_overhead();
+static double theory_fpr(const BloomFilter &filter, size_t n);
+
+
+/*
+ * BloomFilter 的基准测试，分为三部分：
+ *
+ *   fpr        不同 bits_per_key 下实际的误判率与理论值
+ *   scale      key 的个数从 1M 增加到 max_keys(每次乘以 10)时的插入吞吐、
+ *              命中/未命中查询的延迟分布、误判率以及每个 key 占用的内存
+ *   reduction  固定大小的过滤器使用不同映射方式时的探测耗时
+ *   prefix     对 tenant/table/row 形式的 key 添加前缀之后，
+ *              不存在的前缀的误判率以及对 key 本身误判率的影响
+ *
+ * 1B 个 key、10 bits/key 的位图约 1.2GB，key 边生成边插入，不额外占用内存
+ *
+ * usage: bloom_filter_bench [fpr|scale|reduction|prefix|all] [max_keys]
+ */
+int
+main(int argc, char **argv)
+{
+    size_t       n, max_keys;
+    const char  *what;
+
+    what = (argc > 1) ? argv[1] : "all";
+    max_keys = (argc > 2) ? strtoull(argv[2], NULL, 10) : 10000000;
+
+    if (strcmp(what, "all") != 0 && strcmp(what, "fpr") != 0
+        && strcmp(what, "scale") != 0 && strcmp(what, "reduction") != 0
+        && strcmp(what, "prefix") != 0)
+    {
+        fprintf(stderr,
+                "usage: %s [fpr|scale|reduction|prefix|all] [max_keys]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const bool  all = strcmp(what, "all") == 0;
+    const size_t  first = std::min<size_t>(1000000, max_keys);
+
+    if (all || strcmp(what, "fpr") == 0) {
+        bench_fpr(first);
+    }
+
+    if (all || strcmp(what, "scale") == 0) {
+        printf("\n%-12s %11s %9s %8s %8s %8s %8s %8s %8s %8s %8s %9s\n",
+               "filter", "keys", "insert", "neg-p50", "neg-p99", "neg-p999",
+               "pos-p50", "pos-p99", "pos-p999", "fpr%", "theory%",
+               "bytes/key");
+
+        for (n = first; n <= max_keys; n *= 10) {
+            for (const auto &config : kConfigs) {
+                bench_scale(n, config);
+            }
+        }
+    }
+
+    if (all || strcmp(what, "reduction") == 0) {
+        bench_reduction(first);
+    }
+
+    if (all || strcmp(what, "prefix") == 0) {
+        bench_prefix(first);
+    }
+
+    return 0;
+}
+
+
+/*
+ * 误判率与理论值，理论值按标准布局的公式 (1 - e^(-kn/m))^k 计算，
+ * 分块布局的 key 在块之间分布不均，误判率会略高
+ */
+static void
+bench_fpr(size_t n)
+{
+    printf("%-12s %5s %3s %10s %9s %9s\n", "filter", "bpk", "k",
+           "bits/key", "fpr%", "theory%");
+
+    for (int bits_per_key = 4; bits_per_key <= 20; bits_per_key += 2) {
+        // 反推出对应的误判率，构造出的位图正好是 bits_per_key * n 位
+        const double  fp_rate = exp(-bits_per_key * M_LN2 * M_LN2);
+
+        for (const auto &config : kConfigs) {
+            BloomFilter  filter(n, fp_rate, config.layout,
+                                BloomFilter::kFastRange, config.hash_width);
+            size_t       queries = std::min(n * 4, kMaxFprQueries);
+
+            add_keys(filter, n);
+
+            printf("%-12s %5d %3zu %10.2f %9.4f %9.4f\n", config.name,
+                   bits_per_key, filter.NumProbes(),
+                   filter.BitmapSize() * 8.0 / n,
+                   100.0 * count_false_positives(filter, queries) / queries,
+                   100.0 * theory_fpr(filter, n));
+        }
+    }
+}
+
+
+static void
+bench_scale(size_t n, const Config &config)
+{
+    size_t                    i, queries, fp;
+    double                    insert_ns;
+    std::vector<double>       neg, pos;
+    std::vector<std::string>  keys;
+    BloomFilter               filter(n, 0.01, config.layout,
+                                     BloomFilter::kFastRange,
+                                     config.hash_width);
+
+    auto start = std::chrono::steady_clock::now();
+    add_keys(filter, n);
+    insert_ns = elapsed_ns(start) / n;
+
+    // 采样的 key 均匀地分布在 [0, n) 中，避免集中在同一部分位图上
+    const size_t  samples = std::min(n, kLatencySamples);
+
+    make_keys("key-", 0, samples, n / samples, keys);
+    for (i = 0; i < keys.size(); i++) {
+        if (!filter.KeyMayMatch(keys[i])) {
+            fprintf(stderr, "false negative: %s\n", keys[i].c_str());
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(n));
+    lookup_latency(filter, keys, pos);
+
+    make_keys("absent-", 0, samples, 1, keys);
+    lookup_latency(filter, keys, neg);
+
+    queries = std::min(n, kMaxFprQueries);
+    fp = count_false_positives(filter, queries);
+
+    printf("%-12s %11zu %9.1f %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f "
+           "%8.4f %8.4f %9.2f\n", config.name, n, insert_ns,
+           percentile(neg, 0.5), percentile(neg, 0.99),
+           percentile(neg, 0.999), percentile(pos, 0.5),
+           percentile(pos, 0.99), percentile(pos, 0.999),
+           100.0 * fp / queries, 100.0 * theory_fpr(filter, n),
+           1.0 * filter.ApproximateMemoryUsage() / n);
+}
+
+
+/*
+ * 只测探测本身，hash 事先算好
+ */
+static void
+bench_reduction(size_t n)
+{
+    size_t                    i, fp;
+    double                    ns;
+    std::vector<uint32_t>     hashes;
+    std::vector<std::string>  keys;
+    static const char        *names[] = { "modulo", "power-of-2",
+                                          "fastrange" };
+
+    make_keys("absent-", 0, n, 1, keys);
+
+    hashes.reserve(n);
+    for (i = 0; i < n; i++) {
+        hashes.push_back(BloomHash(keys[i]));
+    }
+
+    make_keys("key-", 0, n, 1, keys);
+
+    printf("\n%-9s %-11s %10s %9s %9s\n", "layout", "reduction",
+           "bits/key", "fpr%", "probe-ns");
+
+    for (int layout = BloomFilter::kStandard; layout <= BloomFilter::kBlocked;
+         layout++)
+    {
+        for (int reduction = BloomFilter::kModulo;
+             reduction <= BloomFilter::kFastRange; reduction++)
+        {
+            BloomFilter  filter(n, 0.01,
+                                static_cast<BloomFilter::Layout>(layout),
+                                static_cast<BloomFilter::Reduction>(reduction));
+
+            filter.Build(keys, 1);
+
+            auto start = std::chrono::steady_clock::now();
+
+            fp = 0;
+            for (i = 0; i < n; i++) {
+                fp += filter.HashMayMatch(hashes[i]);
+            }
+
+            ns = elapsed_ns(start) / n;
+
+            printf("%-9s %-11s %10.2f %9.4f %9.1f\n",
+                   layout == BloomFilter::kBlocked ? "blocked" : "standard",
+                   names[reduction], filter.BitmapSize() * 8.0 / n,
+                   100.0 * fp / n, ns);
+        }
+    }
+}
+
+
+/*
+ * 100 个 tenant，每个 tenant 100 张表，行平均分配到每张表中，
+ * 查询同样数量的不存在的表和 tenant
+ */
+static void
+bench_prefix(size_t n)
+{
+    size_t                    i, depth, fp_key, fp_table, fp_tenant;
+    char                      buf[64];
+    std::vector<std::string>  keys, tables, tenants, absent;
+
+    keys.reserve(n);
+    for (i = 0; i < n; i++) {
+        keys.emplace_back(buf, snprintf(buf, sizeof(buf),
+                                        "tenant%zu/table%zu/row%zu",
+                                        i % 100, i / 100 % 100, i));
+    }
+
+    for (i = 0; i < 100000; i++) {
+        tables.emplace_back(buf, snprintf(buf, sizeof(buf), "tenant%zu/t%zu/",
+                                          i % 100, i));
+        tenants.emplace_back(buf, snprintf(buf, sizeof(buf), "tenant-%zu/",
+                                           i));
+    }
+
+    make_keys("absent-", 0, n, 1, absent);
+
+    printf("\n%-6s %10s %10s %11s %11s\n", "depth", "bits/key", "key-fpr%",
+           "table-fpr%", "tenant-fpr%");
+
+    for (depth = 0; depth <= 2; depth++) {
+        BloomFilter  filter(n, 0.01, BloomFilter::kStandard,
+                            BloomFilter::kFastRange, BloomFilter::kHash64);
+
+        filter.SetPrefixPolicy('/', depth);
+        filter.Build(keys, 1);
+
+        for (i = 0; i < n; i += 997) {
+            if (!filter.PrefixMayMatch(keys[i].substr(0, keys[i].rfind('/')))
+                || !filter.RangeMayMatch(keys[i], keys[i]))
+            {
+                fprintf(stderr, "false negative: %s\n", keys[i].c_str());
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        fp_key = fp_table = fp_tenant = 0;
+
+        for (i = 0; i < absent.size(); i++) {
+            fp_key += filter.KeyMayMatch(absent[i]);
+        }
+
+        for (i = 0; i < tables.size(); i++) {
+            fp_table += filter.PrefixMayMatch(tables[i]);
+            fp_tenant += filter.PrefixMayMatch(tenants[i]);
+        }
+
+        printf("%-6zu %10.2f %10.4f %11.4f %11.4f\n", depth,
+               filter.BitmapSize() * 8.0 / n, 100.0 * fp_key / absent.size(),
+               100.0 * fp_table / tables.size(),
+               100.0 * fp_tenant / tenants.size());
+    }
+}
+
+
+/*
+ * 生成 prefix + (begin + i * stride)，i 属于 [0, end - begin)
+ */
+static void
+make_keys(const char *prefix, size_t begin, size_t end, size_t stride,
+    std::vector<std::string> &keys)
+{
+    char  buf[64];
+
+    keys.clear();
+    keys.reserve(end - begin);
+
+    for (size_t i = begin; i < end; i++) {
+        keys.emplace_back(buf, snprintf(buf, sizeof(buf), "%s%zu", prefix,
+                                        i * stride));
+    }
+}
+
+
+/*
+ * 插入 key-0 到 key-(n-1)，生成 key 的时间也计算在内，
+ * 与实际使用时从外部读入 key 的情形相近
+ */
+static void
+add_keys(BloomFilter &filter, size_t n)
+{
+    std::vector<std::string>  keys;
+
+    for (size_t i = 0; i < n; i += kKeyChunk) {
+        make_keys("key-", i, std::min(i + kKeyChunk, n), 1, keys);
+
+        for (const auto &key : keys) {
+            filter.AddKey(key);
+        }
+    }
+}
+
+
+static size_t
+count_false_positives(const BloomFilter &filter, size_t n)
+{
+    size_t                    fp = 0;
+    std::vector<std::string>  keys;
+
+    for (size_t i = 0; i < n; i += kKeyChunk) {
+        make_keys("absent-", i, std::min(i + kKeyChunk, n), 1, keys);
+
+        for (const auto &key : keys) {
+            fp += filter.KeyMayMatch(key);
+        }
+    }
+
+    return fp;
+}
+
+
+/*
+ * 逐个计时，减去计时本身的开销，结果按升序排列
+ */
+static void
+lookup_latency(const BloomFilter &filter,
+    const std::vector<std::string> &keys, std::vector<double> &latency)
+{
+    static const double  overhead = timer_overhead();
+    size_t               matched = 0;
+
+    latency.resize(keys.size());
+
+    for (size_t i = 0; i < keys.size(); i++) {
+        auto start = std::chrono::steady_clock::now();
+        matched += filter.KeyMayMatch(keys[i]);
+        latency[i] = std::max(0.0, elapsed_ns(start) - overhead);
+    }
+
+    // 防止编译器把查询优化掉
+    if (matched > keys.size()) {
+        abort();
+    }
+
+    std::sort(latency.begin(), latency.end());
+}
+
+
+static double
+percentile(const std::vector<double> &sorted, double p)
+{
+    return sorted[std::min(sorted.size() - 1,
+                           static_cast<size_t>(sorted.size() * p))];
+}
+
+
+static double
+timer_overhead()
+{
+    double  best = 1e9;
+
+    for (int i = 0; i < 10000; i++) {
+        auto start = std::chrono::steady_clock::now();
+        best = std::min(best, elapsed_ns(start));
+    }
+
+    return best;
+}
+
+
+static double
+theory_fpr(const BloomFilter &filter, size_t n)
+{
+    const double  m = filter.BitmapSize() * 8.0;
+    const double  k = filter.NumProbes();
+
+    return pow(1 - exp(-k * n / m), k);
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <stdio.h>
+#include <bloom_filter.hh>
+
+
+int
+main(int argc, char **argv)
+{
+    bool         exist;
+    std::string  bitmap;
+    BloomFilter  bloom_filter(3);
+
+    std::vector<std::string> keys =
+        { "abc", "leveldb", "moon", "funny", "lucy", "tommy",
+          "rimbaud", "tom", "pikazza", "chythia", "kolo", "meetyou" };
+    std::vector<std::string> keys2 =
+        { "hello", "world", "who", "programming language pragmatics",
+          "jerry", "sam", "nice", "whoami", "locate", "network", "iamyou" };
+
+
+    for (size_t i = 0; i < keys.size(); i++) {
+        bloom_filter.AddKey(keys[i]);
+    }
+
+
+    for (size_t i = 0; i < keys.size(); i++) {
+        exist = bloom_filter.KeyMayMatch(keys[i]);
+        printf("exist(%s): %d\n", keys[i].c_str(), exist);
+    }
+
+    printf("\n");
+
+    for (size_t i = 0; i < keys2.size(); i++) {
+        exist = bloom_filter.KeyMayMatch(keys2[i]);
+        printf("exist(%s): %d\n", keys2[i].c_str(), exist);
+    }
+
+    return 0;
+}
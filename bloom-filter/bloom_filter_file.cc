@@ -0,0 +1,389 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <bloom_filter.hh>
+
+
+/*
+ * 文件格式(小端序)：
+ *
+ *   +-----------------------+  0
+ *   | BloomFileHeader       |
+ *   +-----------------------+  64
+ *   | 位图                   |
+ *   +-----------------------+
+ *
+ * 头部正好是一个 cache line，mmap 之后位图也是按 cache line 对齐的
+ */
+static const char      kBloomFileMagic[8] = { 'B', 'L', 'O', 'O',
+                                              'M', 'F', 'L', 'T' };
+static const uint32_t  kBloomFileVersion = 1;
+
+
+struct BloomFileHeader {
+    char      magic[8];
+    uint32_t  version;
+    uint32_t  layout;
+    uint32_t  k;
+    uint32_t  bits_per_key;
+    uint64_t  nbits;
+    uint64_t  num_keys;
+    uint32_t  seed;
+    /* 位图的 CRC32 */
+    uint32_t  checksum;
+    /* 早期的文件这里为 0，即 kModulo */
+    uint32_t  reduction;
+    /* hash 的位数，早期的文件这里为 0，即 32 位 */
+    uint32_t  hash_bits;
+    /* 前缀的设置，早期的文件这里为 0，即不添加前缀 */
+    uint8_t   prefix_delimiter;
+    uint8_t   prefix_depth;
+    char      reserved[6];
+};
+
+static_assert(sizeof(BloomFileHeader) == kCacheLineSize,
+              "bloom filter file header must fill one cache line");
+
+
+struct Crc32Table {
+    uint32_t  entries[256];
+
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t  crc = i;
+
+            for (int j = 0; j < 8; j++) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+            }
+
+            entries[i] = crc;
+        }
+    }
+};
+
+
+static uint32_t
+Crc32(const char *data, size_t len)
+{
+    static const Crc32Table  table;
+    uint32_t                 crc = 0xffffffff;
+
+    for (size_t i = 0; i < len; i++) {
+        crc = table.entries[(crc ^ static_cast<unsigned char>(data[i])) & 0xff]
+              ^ (crc >> 8);
+    }
+
+    return crc ^ 0xffffffff;
+}
+
+
+/*
+ * 检查文件头，file_size 为文件的总长度
+ */
+static bool
+CheckHeader(const BloomFileHeader &header, uint64_t file_size)
+{
+    static const char  zero[sizeof(header.reserved)] = { 0 };
+
+    if (memcmp(header.magic, kBloomFileMagic, sizeof(kBloomFileMagic)) != 0
+        || header.version != kBloomFileVersion
+        || header.seed != kBloomHashSeed
+        || header.layout > BloomFilter::kBlocked
+        || header.reduction > BloomFilter::kFastRange
+        || (header.hash_bits != 0 && header.hash_bits != 32
+            && header.hash_bits != 64)
+        || header.k < 1 || header.k > 30
+        || header.nbits % 64 != 0
+        || memcmp(header.reserved, zero, sizeof(zero)) != 0)
+    {
+        return false;
+    }
+
+    if (header.layout == BloomFilter::kBlocked
+        && header.nbits % (kCacheLineSize * 8) != 0)
+    {
+        return false;
+    }
+
+    if (header.reduction == BloomFilter::kPowerOfTwo
+        && (header.nbits & (header.nbits - 1)) != 0)
+    {
+        return false;
+    }
+
+    return file_size == sizeof(header) + header.nbits / 8;
+}
+
+
+BloomFilter::Mapping::~Mapping()
+{
+    munmap(addr, length);
+}
+
+
+BloomFilter::BloomFilter()
+    : bits_per_key_(0), k_(1), layout_(kStandard), reduction_(kModulo),
+      hash_width_(kHash32), fixed_(true), num_keys_(0), prefix_delimiter_(0),
+      prefix_depth_(0), map_data_(NULL), map_size_(0)
+{
+}
+
+
+/*
+ * rename 之后 fsync 文件所在的目录，否则崩溃后目录项可能还是旧的
+ */
+static bool
+SyncDirectory(const std::string &path)
+{
+    int                fd;
+    const size_t       slash = path.rfind('/');
+    const std::string  dir = (slash == std::string::npos) ? "."
+                             : (slash == 0) ? "/" : path.substr(0, slash);
+
+    fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd == -1) {
+        return false;
+    }
+
+    if (fsync(fd) != 0) {
+        const int  err = errno;
+
+        close(fd);
+        errno = err;
+        return false;
+    }
+
+    close(fd);
+    return true;
+}
+
+
+bool
+BloomFilter::Save(const std::string &path) const
+{
+    int               fd;
+    FILE             *fp;
+    BloomFileHeader   header;
+    std::string       tmp = path + ".XXXXXX";
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kBloomFileMagic, sizeof(kBloomFileMagic));
+    header.version = kBloomFileVersion;
+    header.layout = layout_;
+    header.reduction = reduction_;
+    header.hash_bits = (hash_width_ == kHash64) ? 64 : 32;
+    header.prefix_delimiter = static_cast<uint8_t>(prefix_delimiter_);
+    header.prefix_depth = static_cast<uint8_t>(prefix_depth_);
+    header.k = k_;
+    header.bits_per_key = bits_per_key_;
+    header.nbits = Size() * 8;
+    header.num_keys = num_keys_;
+    header.seed = kBloomHashSeed;
+    header.checksum = Crc32(Data(), Size());
+
+    /* 临时文件名唯一，多个进程同时保存到同一个 path 不会互相覆盖 */
+    fd = mkstemp(&tmp[0]);
+    if (fd == -1) {
+        return false;
+    }
+
+    /* mkstemp 创建的文件只有属主可读，其他进程还要能 Map */
+    if (fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) != 0
+        || (fp = fdopen(fd, "wb")) == NULL)
+    {
+        const int  err = errno;
+
+        close(fd);
+        unlink(tmp.c_str());
+        errno = err;
+        return false;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, fp) != 1
+        || (Size() > 0 && fwrite(Data(), Size(), 1, fp) != 1)
+        || fflush(fp) != 0
+        || fsync(fileno(fp)) != 0)
+    {
+        const int  err = errno;
+
+        fclose(fp);
+        unlink(tmp.c_str());
+        errno = err;
+        return false;
+    }
+
+    if (fclose(fp) != 0 || rename(tmp.c_str(), path.c_str()) != 0) {
+        const int  err = errno;
+
+        unlink(tmp.c_str());
+        errno = err;
+        return false;
+    }
+
+    return SyncDirectory(path);
+}
+
+
+std::unique_ptr<BloomFilter>
+BloomFilter::Load(const std::string &path)
+{
+    FILE                          *fp;
+    struct stat                    st;
+    BloomFileHeader                header;
+    std::unique_ptr<BloomFilter>   filter(new BloomFilter());
+
+    fp = fopen(path.c_str(), "rb");
+    if (fp == NULL) {
+        return nullptr;
+    }
+
+    if (fstat(fileno(fp), &st) != 0) {
+        goto failed;
+    }
+
+    if (fread(&header, sizeof(header), 1, fp) != 1) {
+        if (!ferror(fp)) {
+            errno = EINVAL;
+        }
+
+        goto failed;
+    }
+
+    if (!CheckHeader(header, st.st_size)) {
+        errno = EINVAL;
+        goto failed;
+    }
+
+    filter->bitmap_.resize(header.nbits / 8);
+
+    if (header.nbits > 0
+        && fread(&filter->bitmap_[0], header.nbits / 8, 1, fp) != 1)
+    {
+        if (!ferror(fp)) {
+            errno = EINVAL;
+        }
+
+        goto failed;
+    }
+
+    if (Crc32(filter->bitmap_.data(), filter->bitmap_.size())
+        != header.checksum)
+    {
+        errno = EINVAL;
+        goto failed;
+    }
+
+    fclose(fp);
+
+    filter->layout_ = static_cast<Layout>(header.layout);
+    filter->reduction_ = static_cast<Reduction>(header.reduction);
+    filter->hash_width_ = (header.hash_bits == 64) ? kHash64 : kHash32;
+    filter->k_ = header.k;
+    filter->bits_per_key_ = header.bits_per_key;
+    filter->num_keys_ = header.num_keys;
+    filter->prefix_delimiter_ = static_cast<char>(header.prefix_delimiter);
+    filter->prefix_depth_ = header.prefix_depth;
+
+    return filter;
+
+failed:
+
+    {
+        const int  err = errno;
+
+        fclose(fp);
+        errno = err;
+    }
+
+    return nullptr;
+}
+
+
+std::unique_ptr<BloomFilter>
+BloomFilter::Map(const std::string &path, bool verify_checksum,
+    Access access)
+{
+    int                            fd;
+    void                          *addr;
+    struct stat                    st;
+    std::unique_ptr<BloomFilter>   filter(new BloomFilter());
+
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return nullptr;
+    }
+
+    if (fstat(fd, &st) != 0) {
+        const int  err = errno;
+
+        close(fd);
+        errno = err;
+        return nullptr;
+    }
+
+    if (static_cast<size_t>(st.st_size) < sizeof(BloomFileHeader)) {
+        close(fd);
+        errno = EINVAL;
+        return nullptr;
+    }
+
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    if (addr == MAP_FAILED) {
+        const int  err = errno;
+
+        close(fd);
+        errno = err;
+        return nullptr;
+    }
+
+    // 映射建立之后就可以关闭文件
+    close(fd);
+
+    filter->mapping_ = std::make_shared<Mapping>();
+    filter->mapping_->addr = addr;
+    filter->mapping_->length = st.st_size;
+
+    const BloomFileHeader  *header = static_cast<BloomFileHeader *>(addr);
+
+    filter->map_data_ = static_cast<const char *>(addr) + sizeof(*header);
+    filter->map_size_ = header->nbits / 8;
+
+    if (!CheckHeader(*header, st.st_size)) {
+        errno = EINVAL;
+        return nullptr;
+    }
+
+    if (verify_checksum) {
+        /* 计算校验和要顺序读完整个位图，先打开预读 */
+        madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+        if (Crc32(filter->map_data_, filter->map_size_) != header->checksum) {
+            errno = EINVAL;
+            return nullptr;
+        }
+    }
+
+    /* 查询是随机访问，关掉预读；合并等顺序读取的场合保持预读 */
+    madvise(addr, st.st_size,
+            (access == kSequentialAccess) ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+    filter->layout_ = static_cast<Layout>(header->layout);
+    filter->reduction_ = static_cast<Reduction>(header->reduction);
+    filter->hash_width_ = (header->hash_bits == 64) ? kHash64 : kHash32;
+    filter->k_ = header->k;
+    filter->bits_per_key_ = header->bits_per_key;
+    filter->num_keys_ = header->num_keys;
+    filter->prefix_delimiter_ = static_cast<char>(header->prefix_delimiter);
+    filter->prefix_depth_ = header->prefix_depth;
+
+    return filter;
+}
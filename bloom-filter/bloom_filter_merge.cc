@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <bloom_filter.hh>
+
+
+/*
+ * 把多个由 BloomFilter::Save 写出的过滤器合并为一个，默认求并集，
+ * -i 求交集。所有输入必须用同样的参数构造
+ *
+ * usage: bloom_filter_merge [-i] <output> <input>...
+ */
+int
+main(int argc, char **argv)
+{
+    int                            i = 1;
+    bool                           intersect = false;
+    std::unique_ptr<BloomFilter>   result, input;
+
+    if (argc > 1 && strcmp(argv[1], "-i") == 0) {
+        intersect = true;
+        i++;
+    }
+
+    if (argc - i < 2) {
+        fprintf(stderr, "usage: %s [-i] <output> <input>...\n", argv[0]);
+        return 1;
+    }
+
+    const char  *output = argv[i++];
+
+    // 第一个文件读入内存作为结果，其余的只需 mmap 之后顺序读一遍
+    result = BloomFilter::Load(argv[i]);
+    if (result == nullptr) {
+        perror(argv[i]);
+        return 1;
+    }
+
+    for (i++; i < argc; i++) {
+        input = BloomFilter::Map(argv[i], true,
+                                 BloomFilter::kSequentialAccess);
+        if (input == nullptr) {
+            perror(argv[i]);
+            return 1;
+        }
+
+        if (!(intersect ? result->Intersect(*input) : result->Union(*input))) {
+            perror(argv[i]);
+            return 1;
+        }
+    }
+
+    if (!result->Save(output)) {
+        perror(output);
+        return 1;
+    }
+
+    printf("%s: %zu bytes, k = %zu, ~%zu keys\n", output,
+           result->BitmapSize(), result->NumProbes(), result->NumKeys());
+
+    return 0;
+}
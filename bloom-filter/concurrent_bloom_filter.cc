@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <assert.h>
+#include <algorithm>
+#include <concurrent_bloom_filter.hh>
+
+
+/* 分块布局下每个块(一个 cache line)包含的 64 位整数个数 */
+static const size_t  kWordsPerBlock = kCacheLineSize / sizeof(uint64_t);
+
+
+static size_t
+NumWords(size_t expected_keys, double fp_rate, BloomFilter::Layout layout)
+{
+    const size_t  align = (layout == BloomFilter::kBlocked) ? kWordsPerBlock
+                                                            : 1;
+    size_t        nwords;
+
+    nwords = static_cast<size_t>(ceil(std::max<size_t>(expected_keys, 1)
+                                      * BloomBitsPerKey(fp_rate) / 64));
+
+    return (nwords + align - 1) / align * align;
+}
+
+
+/*
+ * 先读一次，位已经置上时不做写操作，避免 cache line 在核之间来回传递
+ * 返回这一位是否是本次置上的
+ */
+static inline bool
+SetBit(std::atomic<uint64_t> *words, size_t bitpos)
+{
+    const uint64_t  mask = uint64_t(1) << (bitpos % 64);
+
+    if (words[bitpos / 64].load(std::memory_order_relaxed) & mask) {
+        return false;
+    }
+
+    return (words[bitpos / 64].fetch_or(mask, std::memory_order_relaxed)
+            & mask) == 0;
+}
+
+
+static inline bool
+TestBit(const std::atomic<uint64_t> *words, size_t bitpos)
+{
+    return words[bitpos / 64].load(std::memory_order_relaxed)
+           & (uint64_t(1) << (bitpos % 64));
+}
+
+
+ConcurrentBloomFilter::ConcurrentBloomFilter(size_t expected_keys,
+    double fp_rate, BloomFilter::Layout layout)
+    : k_(BloomNumProbes(BloomBitsPerKey(fp_rate))), layout_(layout),
+      nwords_(NumWords(expected_keys, fp_rate, layout)),
+      // 值初始化，所有的位都为 0
+      words_(nwords_)
+{
+    assert(fp_rate > 0 && fp_rate < 1);
+}
+
+
+bool
+ConcurrentBloomFilter::AddKey(const std::string &key)
+{
+    return AddHash(BloomHash(key));
+}
+
+
+bool
+ConcurrentBloomFilter::AddHash(uint32_t h)
+{
+    bool   added = false;
+    Word  *words = &words_[0];
+
+    BloomProbe<BloomFilter::kFastRange>(h, k_,
+        layout_ == BloomFilter::kBlocked, nwords_ * 64,
+        [words, &added](size_t bitpos) {
+            added |= SetBit(words, bitpos);
+            return true;
+        });
+
+    return added;
+}
+
+
+bool
+ConcurrentBloomFilter::KeyMayMatch(const std::string &key) const
+{
+    return HashMayMatch(BloomHash(key));
+}
+
+
+bool
+ConcurrentBloomFilter::HashMayMatch(uint32_t h) const
+{
+    const Word  *words = &words_[0];
+
+    return BloomProbe<BloomFilter::kFastRange>(h, k_,
+               layout_ == BloomFilter::kBlocked, nwords_ * 64,
+               [words](size_t bitpos) { return TestBit(words, bitpos); });
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <concurrent_bloom_filter.hh>
+
+
+/*
+ * 多个线程同时向同一个过滤器插入 key，每个 key 会被两个线程各插入一次，
+ * 用 AddKey 的返回值去重
+ *
+ * usage: concurrent_bloom_filter_bench [#keys] [#threads]
+ */
+int
+main(int argc, char **argv)
+{
+    size_t                    n, nthreads, t, i, unique, missing;
+    std::vector<std::string>  keys;
+    std::vector<size_t>       added;
+    std::vector<std::thread>  workers;
+
+    n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 4000000;
+    nthreads = (argc > 2) ? strtoul(argv[2], NULL, 10) : 32;
+
+    keys.reserve(n);
+    for (i = 0; i < n; i++) {
+        keys.push_back("key-" + std::to_string(i));
+    }
+
+    ConcurrentBloomFilter  filter(n, 0.01);
+
+    added.resize(nthreads, 0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (t = 0; t < nthreads; t++) {
+        workers.emplace_back([&, t]() {
+            // 第 t 个线程插入 [t, t+2) 两段 key，相邻线程之间互相重复
+            for (size_t part = t; part < t + 2; part++) {
+                const size_t  begin = (part % nthreads) * n / nthreads;
+                const size_t  end = (part % nthreads + 1) * n / nthreads;
+
+                for (size_t j = begin; j < end; j++) {
+                    added[t] += filter.AddKey(keys[j]);
+                    filter.KeyMayMatch(keys[(j * 7919) % n]);
+                }
+            }
+        });
+    }
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+    unique = missing = 0;
+    for (t = 0; t < nthreads; t++) {
+        unique += added[t];
+    }
+
+    for (i = 0; i < n; i++) {
+        missing += !filter.KeyMayMatch(keys[i]);
+    }
+
+    printf("threads: %zu, inserts: %zu, %.1f ns/insert+lookup, "
+           "%.2f Mops/s\n", nthreads, 2 * n, ns / (2 * n), 2 * n * 1e3 / ns);
+    printf("unique by AddKey(): %zu of %zu, false negatives: %zu\n",
+           unique, n, missing);
+
+    return missing ? EXIT_FAILURE : EXIT_SUCCESS;
+}
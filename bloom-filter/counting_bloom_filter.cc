@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <assert.h>
+#include <algorithm>
+#include <counting_bloom_filter.hh>
+
+
+/* 4 位计数器的最大值，达到后不再增减 */
+static const unsigned  kCounterMax = 0x0f;
+
+
+CountingBloomFilter::CountingBloomFilter(size_t expected_keys, double fp_rate)
+{
+    assert(fp_rate > 0 && fp_rate < 1);
+
+    const double  bits_per_key = BloomBitsPerKey(fp_rate);
+    size_t        n;
+
+    k_ = BloomNumProbes(bits_per_key);
+
+    // 每个字节两个计数器
+    n = static_cast<size_t>(
+            ceil(std::max<size_t>(expected_keys, 1) * bits_per_key));
+    counters_.resize((n + 1) / 2, 0);
+}
+
+
+void
+CountingBloomFilter::AddKey(const std::string &key)
+{
+    BloomProbe<BloomFilter::kModulo>(BloomHash(key), k_, false, NumCounters(),
+        [this](size_t pos) {
+            const unsigned  count = Counter(pos);
+
+            if (count < kCounterMax) {
+                SetCounter(pos, count + 1);
+            }
+
+            return true;
+        });
+}
+
+
+bool
+CountingBloomFilter::RemoveKey(const std::string &key)
+{
+    const uint32_t  h = BloomHash(key);
+
+    /* 先确认 k 个计数器都不为 0，再用同一个 h 逐个减一 */
+    if (!HashMayMatch(h)) {
+        return false;
+    }
+
+    BloomProbe<BloomFilter::kModulo>(h, k_, false, NumCounters(),
+        [this](size_t pos) {
+            const unsigned  count = Counter(pos);
+
+            /*
+             * 同一个 key 的两次探测可能落在同一个计数器上，
+             * 添加时加了两次，这里也会减两次
+             */
+            if (count > 0 && count < kCounterMax) {
+                SetCounter(pos, count - 1);
+            }
+
+            return true;
+        });
+
+    return true;
+}
+
+
+bool
+CountingBloomFilter::KeyMayMatch(const std::string &key) const
+{
+    return HashMayMatch(BloomHash(key));
+}
+
+
+bool
+CountingBloomFilter::HashMayMatch(uint32_t h) const
+{
+    return BloomProbe<BloomFilter::kModulo>(h, k_, false, NumCounters(),
+               [this](size_t pos) { return Counter(pos) != 0; });
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <counting_bloom_filter.hh>
+#include <bench_timer.hh>
+
+
+static void check(bool ok, const char *what);
+static double false_positive_rate(const CountingBloomFilter &filter,
+    const std::vector<std::string> &keys, size_t first, size_t step);
+
+
+/*
+ * 检查 CountingBloomFilter 的插入、删除和计数器饱和：
+ *
+ *   1. 插入 n 个 key，不能有假阴性
+ *   2. 删除下标为奇数的 key，剩下的 key 仍然全部命中，被删除的 key
+ *      的误判率应当接近只插入一半 key 时的误判率
+ *   3. 同一个 key 插入 20 次使计数器饱和在 15，再删除 20 次，
+ *      饱和的计数器不再减少，key 仍然命中
+ *
+ * usage: counting_bloom_filter_bench [#keys]
+ */
+int
+main(int argc, char **argv)
+{
+    size_t                    n, i, found;
+    double                    add_ns, hit_ns, remove_ns;
+    std::vector<std::string>  keys, absent;
+
+    n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+
+    for (i = 0; i < n; i++) {
+        keys.push_back("key-" + std::to_string(i));
+        absent.push_back("absent-" + std::to_string(i));
+    }
+
+    CountingBloomFilter  filter(n, 0.01);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (i = 0; i < n; i++) {
+        filter.AddKey(keys[i]);
+    }
+
+    add_ns = elapsed_ns(start) / n;
+
+    start = std::chrono::steady_clock::now();
+
+    found = 0;
+    for (i = 0; i < n; i++) {
+        found += filter.KeyMayMatch(keys[i]);
+    }
+
+    hit_ns = elapsed_ns(start) / n;
+    check(found == n, "false negative after insertion");
+
+    printf("counters: %zu (%.2f bits/key), probes: %zu\n",
+           filter.NumCounters(), filter.NumCounters() * 4.0 / n,
+           filter.NumProbes());
+    printf("fpr with %zu keys: %.4f%%\n", n,
+           100 * false_positive_rate(filter, absent, 0, 1));
+
+    start = std::chrono::steady_clock::now();
+
+    for (i = 1; i < n; i += 2) {
+        check(filter.RemoveKey(keys[i]), "RemoveKey of an added key failed");
+    }
+
+    remove_ns = elapsed_ns(start) / (n / 2);
+
+    for (i = 0; i < n; i += 2) {
+        check(filter.KeyMayMatch(keys[i]), "false negative after removal");
+    }
+
+    printf("fpr after removing %zu keys: absent %.4f%%, removed %.4f%%\n",
+           n / 2, 100 * false_positive_rate(filter, absent, 0, 1),
+           100 * false_positive_rate(filter, keys, 1, 2));
+
+    /* 一定不存在的 key 删除时返回 false，并且不影响其他 key */
+    for (i = 0; i < n; i++) {
+        if (!filter.KeyMayMatch(absent[i])) {
+            check(!filter.RemoveKey(absent[i]),
+                  "RemoveKey of an absent key returned true");
+        }
+    }
+
+    for (i = 0; i < n; i += 2) {
+        check(filter.KeyMayMatch(keys[i]),
+              "false negative after removing absent keys");
+    }
+
+    CountingBloomFilter  small(100, 0.01);
+
+    for (i = 0; i < 20; i++) {
+        small.AddKey("hot");
+    }
+
+    small.AddKey("cold");
+
+    for (i = 0; i < 20; i++) {
+        small.RemoveKey("hot");
+    }
+
+    check(small.KeyMayMatch("hot"), "saturated counter was decremented");
+    check(small.KeyMayMatch("cold"), "false negative next to a hot key");
+
+    printf("add: %.1f ns, hit: %.1f ns, remove: %.1f ns\n", add_ns, hit_ns,
+           remove_ns);
+    printf("ok\n");
+
+    return 0;
+}
+
+
+static void
+check(bool ok, const char *what)
+{
+    if (!ok) {
+        fprintf(stderr, "%s\n", what);
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+static double
+false_positive_rate(const CountingBloomFilter &filter,
+    const std::vector<std::string> &keys, size_t first, size_t step)
+{
+    size_t  i, fp = 0, total = 0;
+
+    for (i = first; i < keys.size(); i += step) {
+        fp += filter.KeyMayMatch(keys[i]);
+        total++;
+    }
+
+    return (double) fp / total;
+}
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <cuckoo_filter.hh>
+
+
+static const size_t    kSlotsPerBucket = 4;
+static const size_t    kMaxKicks = 500;
+
+/* 4 路的桶装载率超过约 95.5% 后插入很容易失败 */
+static const double    kMaxLoadFactor = 0.95;
+
+
+template <typename F, typename B>
+static inline F
+Slot(B bucket, size_t i)
+{
+    return static_cast<F>(bucket >> (i * sizeof(F) * 8));
+}
+
+
+template <typename F, typename B>
+static inline B
+SetSlot(B bucket, size_t i, F fingerprint)
+{
+    const unsigned  shift = i * sizeof(F) * 8;
+    const B         mask = static_cast<F>(~F(0));
+
+    return (bucket & ~(mask << shift)) | (B(fingerprint) << shift);
+}
+
+
+/*
+ * 一次比较桶内的 4 个槽：与指纹相同的槽异或之后为 0，
+ * 有某个槽全为 0 时结果不为 0
+ */
+template <typename F, typename B>
+static inline bool
+HasFingerprint(B bucket, F fingerprint)
+{
+    const B  low = static_cast<B>(~B(0)) / static_cast<F>(~F(0));
+    const B  high = low << (sizeof(F) * 8 - 1);
+    const B  x = bucket ^ (low * fingerprint);
+
+    return ((x - low) & ~x & high) != 0;
+}
+
+
+template <typename F>
+CuckooFilter<F>::CuckooFilter(size_t expected_keys)
+    : num_keys_(0), rand_(0x9e3779b9)
+{
+    size_t  nbuckets;
+
+    /* 桶的个数不必是 2 的幂，见 AltIndex */
+    nbuckets = static_cast<size_t>(ceil(expected_keys
+                                        / (kSlotsPerBucket * kMaxLoadFactor)));
+
+    buckets_.assign(std::max<size_t>(nbuckets, 1), 0);
+    victim_.used = false;
+}
+
+
+/*
+ * 一个 64 位的 hash 同时决定桶和指纹：fastrange 主要用高位选桶，
+ * 指纹取低位，两者几乎独立。0 表示空槽，所以指纹不能为 0
+ */
+template <typename F>
+void
+CuckooFilter<F>::Locate(const std::string &key, size_t *index,
+    F *fingerprint) const
+{
+    const uint64_t  h = BloomHash64(key);
+
+    *index = BloomReduce<BloomFilter::kFastRange>(h, buckets_.size());
+
+    *fingerprint = static_cast<F>(h);
+    if (*fingerprint == 0) {
+        *fingerprint = 1;
+    }
+}
+
+
+/*
+ * 另一个桶为 (f - index) mod n，f 由指纹决定。再算一次得到
+ * f - (f - index) = index，两个桶之间可以来回计算，并且对任意的 n
+ * 都成立，不需要异或所要求的 2 的幂
+ */
+template <typename F>
+size_t
+CuckooFilter<F>::AltIndex(size_t index, F fingerprint) const
+{
+    const size_t  n = buckets_.size();
+    const size_t  f = BloomReduce<BloomFilter::kFastRange>(
+                          uint64_t(fingerprint * 0x9e3779b97f4a7c15ULL), n);
+
+    return (f >= index) ? f - index : f + n - index;
+}
+
+
+template <typename F>
+bool
+CuckooFilter<F>::InsertToBucket(size_t index, F fingerprint)
+{
+    Bucket  bucket = buckets_[index];
+
+    for (size_t i = 0; i < kSlotsPerBucket; i++) {
+        if (Slot<F>(bucket, i) == 0) {
+            buckets_[index] = SetSlot(bucket, i, fingerprint);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+template <typename F>
+bool
+CuckooFilter<F>::RemoveFromBucket(size_t index, F fingerprint)
+{
+    Bucket  bucket = buckets_[index];
+
+    for (size_t i = 0; i < kSlotsPerBucket; i++) {
+        if (Slot<F>(bucket, i) == fingerprint) {
+            buckets_[index] = SetSlot(bucket, i, F(0));
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+template <typename F>
+bool
+CuckooFilter<F>::AddKey(const std::string &key)
+{
+    size_t  index, slot;
+    F       fingerprint, old;
+
+    if (victim_.used) {
+        return false;
+    }
+
+    Locate(key, &index, &fingerprint);
+
+    if (InsertToBucket(index, fingerprint)
+        || InsertToBucket(AltIndex(index, fingerprint), fingerprint))
+    {
+        num_keys_++;
+        return true;
+    }
+
+    /*
+     * 两个桶都满了，随机踢出一个指纹，让它去自己的另一个桶
+     */
+    index = (rand_ & 1) ? AltIndex(index, fingerprint) : index;
+
+    for (size_t n = 0; n < kMaxKicks; n++) {
+        rand_ ^= rand_ << 13;
+        rand_ ^= rand_ >> 17;
+        rand_ ^= rand_ << 5;
+
+        slot = rand_ % kSlotsPerBucket;
+        old = Slot<F>(buckets_[index], slot);
+        buckets_[index] = SetSlot(buckets_[index], slot, fingerprint);
+
+        fingerprint = old;
+        index = AltIndex(index, fingerprint);
+
+        if (InsertToBucket(index, fingerprint)) {
+            num_keys_++;
+            return true;
+        }
+    }
+
+    /* key 本身已经放进去了，只是最后被踢出的指纹没有地方放 */
+    victim_.used = true;
+    victim_.fingerprint = fingerprint;
+    victim_.index = index;
+    num_keys_++;
+
+    return true;
+}
+
+
+template <typename F>
+bool
+CuckooFilter<F>::RemoveKey(const std::string &key)
+{
+    size_t  index, alt;
+    F       fingerprint;
+
+    Locate(key, &index, &fingerprint);
+    alt = AltIndex(index, fingerprint);
+
+    if (RemoveFromBucket(index, fingerprint)
+        || RemoveFromBucket(alt, fingerprint))
+    {
+        num_keys_--;
+
+        /* 可能腾出了位置，试着把暂存的指纹放回去 */
+        if (victim_.used
+            && (InsertToBucket(victim_.index, victim_.fingerprint)
+                || InsertToBucket(AltIndex(victim_.index, victim_.fingerprint),
+                                  victim_.fingerprint)))
+        {
+            victim_.used = false;
+        }
+
+        return true;
+    }
+
+    if (victim_.used && victim_.fingerprint == fingerprint
+        && (victim_.index == index || victim_.index == alt))
+    {
+        victim_.used = false;
+        num_keys_--;
+        return true;
+    }
+
+    return false;
+}
+
+
+template <typename F>
+bool
+CuckooFilter<F>::KeyMayMatch(const std::string &key) const
+{
+    size_t  index, alt;
+    F       fingerprint;
+
+    Locate(key, &index, &fingerprint);
+    alt = AltIndex(index, fingerprint);
+
+    if (victim_.used && victim_.fingerprint == fingerprint
+        && (victim_.index == index || victim_.index == alt))
+    {
+        return true;
+    }
+
+    return HasFingerprint(buckets_[index], fingerprint)
+           || HasFingerprint(buckets_[alt], fingerprint);
+}
+
+
+template class CuckooFilter<uint8_t>;
+template class CuckooFilter<uint16_t>;
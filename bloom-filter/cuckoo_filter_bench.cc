@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <bloom_filter.hh>
+#include <cuckoo_filter.hh>
+#include <bench_timer.hh>
+
+
+struct Result {
+    double  bits_per_key;
+    double  fpr;
+    double  insert_ns;
+    double  hit_ns;
+    double  miss_ns;
+};
+
+
+template <typename Filter>
+static Result bench_filter(Filter &filter,
+    const std::vector<std::string> &keys,
+    const std::vector<std::string> &absent);
+template <typename F>
+static bool add_key(CuckooFilter<F> &filter, const std::string &key);
+static bool add_key(BloomFilter &filter, const std::string &key);
+static void print_result(const char *name, const Result &r);
+template <typename F>
+static void compare(const char *name, const std::vector<std::string> &keys,
+    const std::vector<std::string> &absent);
+
+
+/*
+ * 在同样的 key 集合上比较 8 位和 16 位指纹的 CuckooFilter 与误判率相同的
+ * BloomFilter，主要看每个 key 占用的位数
+ *
+ * usage: cuckoo_filter_bench [#keys]
+ */
+int
+main(int argc, char **argv)
+{
+    size_t                    n, i;
+    std::vector<std::string>  keys, absent;
+
+    n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+
+    keys.reserve(n);
+    absent.reserve(n);
+
+    for (i = 0; i < n; i++) {
+        keys.push_back("key-" + std::to_string(i));
+        absent.push_back("absent-" + std::to_string(i));
+    }
+
+    printf("%-20s %10s %9s %10s %8s %8s\n", "filter", "bits/key", "fpr%",
+           "insert-ns", "hit-ns", "miss-ns");
+
+    compare<uint8_t>("cuckoo8", keys, absent);
+    compare<uint16_t>("cuckoo16", keys, absent);
+
+    BloomFilter   dynamic(10);
+    print_result("bloom (10 bpk)", bench_filter(dynamic, keys, absent));
+
+    return 0;
+}
+
+
+/*
+ * 先测 CuckooFilter，再用它实测的误判率构建 BloomFilter
+ */
+template <typename F>
+static void
+compare(const char *name, const std::vector<std::string> &keys,
+    const std::vector<std::string> &absent)
+{
+    CuckooFilter<F>  cuckoo(keys.size());
+    Result           r = bench_filter(cuckoo, keys, absent);
+
+    print_result(name, r);
+
+    const double  fpr = std::max(r.fpr, 1.0 / keys.size());
+
+    BloomFilter   same_fpr(keys.size(), fpr);
+    print_result("  bloom (same fpr)", bench_filter(same_fpr, keys, absent));
+
+    BloomFilter   blocked(keys.size(), fpr, BloomFilter::kBlocked);
+    print_result("  bloom blocked", bench_filter(blocked, keys, absent));
+}
+
+
+template <typename Filter>
+static Result
+bench_filter(Filter &filter, const std::vector<std::string> &keys,
+    const std::vector<std::string> &absent)
+{
+    size_t  i, fp, found;
+    Result  r;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (i = 0; i < keys.size(); i++) {
+        if (!add_key(filter, keys[i])) {
+            fprintf(stderr, "filter is full after %zu keys\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    r.insert_ns = elapsed_ns(start) / keys.size();
+
+    start = std::chrono::steady_clock::now();
+
+    found = 0;
+    for (i = 0; i < keys.size(); i++) {
+        found += filter.KeyMayMatch(keys[i]);
+    }
+
+    r.hit_ns = elapsed_ns(start) / keys.size();
+
+    if (found != keys.size()) {
+        fprintf(stderr, "%zu false negatives\n", keys.size() - found);
+        exit(EXIT_FAILURE);
+    }
+
+    start = std::chrono::steady_clock::now();
+
+    fp = 0;
+    for (i = 0; i < absent.size(); i++) {
+        fp += filter.KeyMayMatch(absent[i]);
+    }
+
+    r.miss_ns = elapsed_ns(start) / absent.size();
+    r.fpr = (double) fp / absent.size();
+    r.bits_per_key = filter.BitmapSize() * 8.0 / keys.size();
+
+    return r;
+}
+
+
+template <typename F>
+static bool
+add_key(CuckooFilter<F> &filter, const std::string &key)
+{
+    return filter.AddKey(key);
+}
+
+
+static bool
+add_key(BloomFilter &filter, const std::string &key)
+{
+    filter.AddKey(key);
+    return true;
+}
+
+
+static void
+print_result(const char *name, const Result &r)
+{
+    printf("%-20s %10.2f %9.4f %10.1f %8.1f %8.1f\n", name, r.bits_per_key,
+           100 * r.fpr, r.insert_ns, r.hit_ns, r.miss_ns);
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <hash.hh>
+
+
+static const size_t  kNumKeys = 1 << 16;
+
+/* 编译期算出的 hash，必须与运行时的结果相同 */
+static constexpr uint32_t  kLiteralHash = Hash("content-type", 0xbc9f1d34);
+static constexpr uint64_t  kLiteralHash64 = Hash64("content-type; charset",
+                                                   0xbc9f1d34);
+
+
+static bool check_hasher(const std::vector<std::string> &keys);
+template <typename Func>
+static double bench(const std::vector<std::string> &keys, size_t rounds,
+    Func hash);
+
+
+/*
+ * 比较 hash.hh 中各个 hash 函数在不同 key 长度下的耗时，
+ * 并检查批量计算、分段计算的结果与一次计算的相同
+ *
+ * usage: hash_bench [#rounds]
+ */
+int
+main(int argc, char **argv)
+{
+    size_t                    rounds, len, i;
+    uint32_t                  out32[kNumKeys];
+    uint64_t                  out64[kNumKeys];
+    std::vector<std::string>  keys;
+    static const size_t       lengths[] = { 4, 8, 16, 24, 32, 64, 256 };
+
+    rounds = (argc > 1) ? strtoul(argv[1], NULL, 10) : 100;
+
+    // 标准的检验值
+    if (Crc32c("123456789", 0) != 0xe3069283
+        || Crc32c("6789", Crc32c("12345", 0)) != 0xe3069283)
+    {
+        fprintf(stderr, "bad crc32c\n");
+        return EXIT_FAILURE;
+    }
+
+    if (kLiteralHash != Hash(std::string("content-type"), 0xbc9f1d34)
+        || kLiteralHash64
+           != Hash64(std::string("content-type; charset"), 0xbc9f1d34))
+    {
+        fprintf(stderr, "constexpr hash mismatch\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%-6s %9s %9s %9s %9s %9s %9s\n", "length", "hash", "hash-x4",
+           "hash64", "hash64-x4", "crc32c", "crc32c-sw");
+
+    for (len = 0; len < sizeof(lengths) / sizeof(lengths[0]); len++) {
+        keys.clear();
+
+        // 长度相同，内容不同，前缀也各不相同
+        for (i = 0; i < kNumKeys; i++) {
+            std::string  key = std::to_string(i * 2654435761u);
+
+            key.resize(lengths[len], 'x');
+            keys.push_back(key);
+        }
+
+        HashBatch(keys.data(), keys.size(), 0xbc9f1d34, out32);
+        Hash64Batch(keys.data(), keys.size(), 0xbc9f1d34, out64);
+
+        for (i = 0; i < kNumKeys; i++) {
+            if (out32[i] != Hash(keys[i], 0xbc9f1d34)
+                || out64[i] != Hash64(keys[i], 0xbc9f1d34))
+            {
+                fprintf(stderr, "batch mismatch: %s\n", keys[i].c_str());
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (!check_hasher(keys)) {
+            return EXIT_FAILURE;
+        }
+
+        printf("%-6zu %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n", lengths[len],
+               bench(keys, rounds, [&](size_t) {
+                   uint32_t  sum = 0;
+
+                   for (const auto &key : keys) {
+                       sum += Hash(key, 0xbc9f1d34);
+                   }
+
+                   return sum;
+               }),
+               bench(keys, rounds, [&](size_t) {
+                   HashBatch(keys.data(), keys.size(), 0xbc9f1d34, out32);
+                   return out32[kNumKeys - 1];
+               }),
+               bench(keys, rounds, [&](size_t) {
+                   uint64_t  sum = 0;
+
+                   for (const auto &key : keys) {
+                       sum += Hash64(key, 0xbc9f1d34);
+                   }
+
+                   return sum;
+               }),
+               bench(keys, rounds, [&](size_t) {
+                   Hash64Batch(keys.data(), keys.size(), 0xbc9f1d34, out64);
+                   return out64[kNumKeys - 1];
+               }),
+               bench(keys, rounds, [&](size_t) {
+                   uint32_t  sum = 0;
+
+                   for (const auto &key : keys) {
+                       sum += HashCrc32c(key, 0xbc9f1d34);
+                   }
+
+                   return sum;
+               }),
+               bench(keys, rounds, [&](size_t) {
+                   uint32_t  sum = 0;
+
+                   for (const auto &key : keys) {
+                       sum += ~Crc32cSoftware(~0u, key.data(), key.size());
+                   }
+
+                   return sum;
+               }));
+    }
+
+    return 0;
+}
+
+
+/*
+ * 把每个 key 随机切成几段交给 Hasher 和 Hasher64
+ */
+static bool
+check_hasher(const std::vector<std::string> &keys)
+{
+    uint32_t  rand = 0x9e3779b9;
+
+    for (const auto &key : keys) {
+        Hasher    hasher(0xbc9f1d34, key.size());
+        Hasher64  hasher64(0xbc9f1d34, key.size());
+        size_t    pos = 0;
+
+        while (pos < key.size()) {
+            rand = rand * 1103515245 + 12345;
+
+            const size_t  len = std::min<size_t>(key.size() - pos,
+                                                 (rand >> 16) % 11);
+
+            hasher.Update(key.data() + pos, len);
+            hasher64.Update(Slice(key.data() + pos, len));
+            pos += len;
+        }
+
+        if (hasher.Final() != Hash(key, 0xbc9f1d34)
+            || hasher64.Final() != Hash64(key, 0xbc9f1d34))
+        {
+            fprintf(stderr, "hasher mismatch: %s\n", key.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/*
+ * 返回每个 key 的平均耗时(ns)
+ */
+template <typename Func>
+static double
+bench(const std::vector<std::string> &keys, size_t rounds, Func hash)
+{
+    volatile uint64_t  sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t r = 0; r < rounds; r++) {
+        sink = sink + hash(r);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count()
+           / (rounds * keys.size());
+}
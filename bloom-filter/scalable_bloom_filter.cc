@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <assert.h>
+#include <scalable_bloom_filter.hh>
+
+
+ScalableBloomFilter::ScalableBloomFilter(double fp_rate,
+    size_t initial_capacity, BloomFilter::Layout layout, size_t growth,
+    double tightening)
+    : fp_rate_(fp_rate), capacity_(initial_capacity), layout_(layout),
+      growth_(growth), tightening_(tightening), num_keys_(0), filled_(0)
+{
+    assert(fp_rate > 0 && fp_rate < 1);
+    assert(initial_capacity > 0 && growth >= 1);
+    assert(tightening > 0 && tightening < 1);
+
+    /*
+     * 第 i 个子过滤器的误判率为 fp_rate * tightening^i，
+     * 为了让总误判率不超过 fp_rate，第一个子过滤器使用 fp_rate * (1 - r)
+     */
+    fp_rate_ = fp_rate * (1 - tightening);
+
+    AddFilter();
+}
+
+
+void
+ScalableBloomFilter::AddFilter()
+{
+    if (!filters_.empty()) {
+        capacity_ *= growth_;
+        fp_rate_ *= tightening_;
+    }
+
+    filled_ = 0;
+
+    filters_.emplace_back(capacity_, fp_rate_, layout_);
+}
+
+
+void
+ScalableBloomFilter::AddKey(const std::string &key)
+{
+    if (filled_ >= capacity_) {
+        AddFilter();
+    }
+
+    filters_.back().AddHash(BloomHash(key));
+    filled_++;
+    num_keys_++;
+}
+
+
+bool
+ScalableBloomFilter::KeyMayMatch(const std::string &key) const
+{
+    const uint32_t  h = BloomHash(key);
+
+    // 越新的子过滤器越大，装的 key 也越多，所以从后往前找
+    for (auto it = filters_.rbegin(); it != filters_.rend(); ++it) {
+        if (it->HashMayMatch(h)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+size_t
+ScalableBloomFilter::ApproximateMemoryUsage() const
+{
+    size_t  usage = sizeof(*this);
+
+    for (const auto &filter : filters_) {
+        usage += filter.ApproximateMemoryUsage();
+    }
+
+    return usage;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <bloom_filter.hh>
+#include <scalable_bloom_filter.hh>
+#include <bench_timer.hh>
+
+
+/*
+ * 比较可扩展 Bloom Filter 与保存全部 key 的 BloomFilter 的内存与插入速度
+ *
+ * usage: scalable_bloom_filter_bench [#keys]
+ */
+int
+main(int argc, char **argv)
+{
+    size_t                    n, i, fp1, fp2;
+    double                    insert1, insert2;
+    std::vector<std::string>  keys, absent;
+
+    n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+
+    keys.reserve(n);
+    absent.reserve(n);
+
+    for (i = 0; i < n; i++) {
+        keys.push_back("user:" + std::to_string(i * 2654435761u)
+                       + ":session");
+        absent.push_back("absent:" + std::to_string(i));
+    }
+
+    BloomFilter          dynamic(10);
+    ScalableBloomFilter  scalable(0.01);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (i = 0; i < n; i++) {
+        dynamic.AddKey(keys[i]);
+    }
+
+    insert1 = elapsed_ns(start) / n;
+
+    start = std::chrono::steady_clock::now();
+
+    for (i = 0; i < n; i++) {
+        scalable.AddKey(keys[i]);
+    }
+
+    insert2 = elapsed_ns(start) / n;
+
+    fp1 = fp2 = 0;
+    for (i = 0; i < n; i++) {
+        if (!dynamic.KeyMayMatch(keys[i]) || !scalable.KeyMayMatch(keys[i])) {
+            fprintf(stderr, "false negative: %s\n", keys[i].c_str());
+            exit(EXIT_FAILURE);
+        }
+
+        fp1 += dynamic.KeyMayMatch(absent[i]);
+        fp2 += scalable.KeyMayMatch(absent[i]);
+    }
+
+    printf("%-10s %12s %12s %10s %8s\n", "filter", "insert-ns", "bytes/key",
+           "fpr%", "filters");
+    printf("%-10s %12.1f %12.2f %10.4f %8d\n", "dynamic", insert1,
+           (double) dynamic.ApproximateMemoryUsage() / n, 100.0 * fp1 / n, 1);
+    printf("%-10s %12.1f %12.2f %10.4f %8zu\n", "scalable", insert2,
+           (double) scalable.ApproximateMemoryUsage() / n, 100.0 * fp2 / n,
+           scalable.NumFilters());
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <mutex>
+#include <sharded_bloom_filter.hh>
+
+
+ShardedBloomFilter::ShardedBloomFilter(int bits_per_key, size_t nshards,
+    BloomFilter::Layout layout)
+{
+    unsigned  bits = 0;
+
+    while ((size_t(1) << bits) < nshards) {
+        bits++;
+    }
+
+    /*
+     * 分片用 hash 的高位选择，分片内部的位图大小是 2 的幂，用的是低位，
+     * 两者互不影响
+     */
+    nshards_ = size_t(1) << bits;
+    shift_ = 32 - bits;
+
+    for (size_t i = 0; i < nshards_; i++) {
+        shards_.emplace_back(new Shard(bits_per_key, layout));
+    }
+}
+
+
+void
+ShardedBloomFilter::AddKey(const std::string &key)
+{
+    const uint32_t  h = BloomHash(key);
+    Shard          &shard = ShardFor(h);
+
+    std::lock_guard<std::shared_timed_mutex>  guard(shard.lock);
+
+    shard.filter.AddHash(h);
+}
+
+
+bool
+ShardedBloomFilter::KeyMayMatch(const std::string &key) const
+{
+    const uint32_t  h = BloomHash(key);
+    Shard          &shard = ShardFor(h);
+
+    std::shared_lock<std::shared_timed_mutex>  guard(shard.lock);
+
+    return shard.filter.HashMayMatch(h);
+}
+
+
+size_t
+ShardedBloomFilter::NumKeys() const
+{
+    size_t  n = 0;
+
+    for (const auto &shard : shards_) {
+        std::shared_lock<std::shared_timed_mutex>  guard(shard->lock);
+
+        n += shard->filter.NumKeys();
+    }
+
+    return n;
+}
+
+
+size_t
+ShardedBloomFilter::ApproximateMemoryUsage() const
+{
+    size_t  usage = sizeof(*this);
+
+    for (const auto &shard : shards_) {
+        std::shared_lock<std::shared_timed_mutex>  guard(shard->lock);
+
+        usage += sizeof(*shard) + shard->filter.ApproximateMemoryUsage();
+    }
+
+    return usage;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <sharded_bloom_filter.hh>
+
+
+static void report(const char *name, std::vector<double> &latency);
+
+
+/*
+ * 比较单个可扩大的 BloomFilter 与分片过滤器插入时的尾延迟，
+ * 单个过滤器每次扩大都要重新 hash 全部 key，这次插入的耗时就是整个重建的耗时
+ *
+ * usage: sharded_bloom_filter_bench [#keys] [#shards]
+ */
+int
+main(int argc, char **argv)
+{
+    size_t                    n, nshards, i, missing;
+    std::vector<double>       latency;
+    std::vector<std::string>  keys;
+
+    n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 2000000;
+    nshards = (argc > 2) ? strtoul(argv[2], NULL, 10) : 64;
+
+    keys.reserve(n);
+    for (i = 0; i < n; i++) {
+        keys.push_back("key-" + std::to_string(i));
+    }
+
+    latency.resize(n);
+
+    printf("%-10s %9s %9s %9s %11s %11s\n", "filter", "mean-ns", "p99-ns",
+           "p99.9-ns", "max-us", "total-ms");
+
+    {
+        // 与分片过滤器一样加锁，保证比较公平
+        std::mutex   lock;
+        BloomFilter  filter(10);
+
+        for (i = 0; i < n; i++) {
+            auto start = std::chrono::steady_clock::now();
+            {
+                std::lock_guard<std::mutex>  guard(lock);
+                filter.AddKey(keys[i]);
+            }
+            auto end = std::chrono::steady_clock::now();
+
+            latency[i] = std::chrono::duration<double, std::nano>(
+                             end - start).count();
+        }
+
+        report("single", latency);
+    }
+
+    ShardedBloomFilter  filter(10, nshards);
+
+    for (i = 0; i < n; i++) {
+        auto start = std::chrono::steady_clock::now();
+        filter.AddKey(keys[i]);
+        auto end = std::chrono::steady_clock::now();
+
+        latency[i] = std::chrono::duration<double, std::nano>(
+                         end - start).count();
+    }
+
+    report("sharded", latency);
+
+    missing = 0;
+    for (i = 0; i < n; i++) {
+        missing += !filter.KeyMayMatch(keys[i]);
+    }
+
+    printf("shards: %zu, keys: %zu, memory: %.2f MB, false negatives: %zu\n",
+           filter.NumShards(), filter.NumKeys(),
+           filter.ApproximateMemoryUsage() / 1048576.0, missing);
+
+    return missing ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+static void
+report(const char *name, std::vector<double> &latency)
+{
+    double  total = 0;
+
+    for (double ns : latency) {
+        total += ns;
+    }
+
+    std::sort(latency.begin(), latency.end());
+
+    printf("%-10s %9.1f %9.1f %9.1f %11.1f %11.1f\n", name,
+           total / latency.size(),
+           latency[latency.size() * 99 / 100],
+           latency[latency.size() * 999 / 1000],
+           latency.back() / 1000, total / 1e6);
+}
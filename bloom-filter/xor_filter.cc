@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <algorithm>
+#include <xor_filter.hh>
+
+
+/* 每段的长度为 (1.23n + 32) / 3，小于这个比例时很难构建成功 */
+static const double  kXorLoadFactor = 1.23;
+static const size_t  kXorSlack = 32;
+
+
+template <typename F>
+XorFilter<F>::XorFilter(const std::vector<std::string> &keys)
+    : num_keys_(keys.size()), seed_(kBloomHashSeed)
+{
+    std::vector<uint64_t>  hashes;
+
+    /*
+     * 32 位的 hash 要同时决定三个位置和指纹，位数不够，用 64 位的 hash。
+     * 相同的 key 会得到三个相同的位置，构建永远不会成功，先去重
+     */
+    hashes.reserve(keys.size());
+    for (const auto &key : keys) {
+        hashes.push_back(BloomHash64(key));
+    }
+
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+
+    block_length_ = static_cast<size_t>(kXorLoadFactor * hashes.size()
+                                        + kXorSlack) / 3;
+    fingerprints_.resize(3 * block_length_);
+
+    // 每次失败的概率约为 3%，换个种子重新混合 hash 即可
+    while (!Construct(hashes)) {
+        seed_ = Mix(seed_);
+    }
+}
+
+
+/*
+ * MurmurHash3 的 fmix64，把种子混合进 key 的 hash
+ */
+template <typename F>
+uint64_t
+XorFilter<F>::Mix(uint64_t h) const
+{
+    h += seed_;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+
+/*
+ * 第 i 个位置，取 h 的不同部分用 fastrange 映射到第 i 段
+ */
+template <typename F>
+size_t
+XorFilter<F>::Index(uint64_t h, int i) const
+{
+    const uint32_t  r = static_cast<uint32_t>((h << (21 * i))
+                                              | (h >> ((64 - 21 * i) & 63)));
+
+    return ((uint64_t(r) * block_length_) >> 32) + i * block_length_;
+}
+
+
+/*
+ * 不断找出只被一个 key 使用的位置并把这个 key 剥离出去，
+ * 全部剥离之后按相反的顺序给每个 key 的这个位置赋值
+ */
+template <typename F>
+bool
+XorFilter<F>::Construct(const std::vector<uint64_t> &hashes)
+{
+    size_t                                      i, j, slot;
+    uint64_t                                    h;
+    const size_t                                size = fingerprints_.size();
+    std::vector<uint32_t>                       count(size, 0);
+    std::vector<uint64_t>                       xormask(size, 0);
+    std::vector<size_t>                         queue;
+    std::vector<std::pair<uint64_t, size_t>>    stack;
+
+    // 每个位置记下使用它的 key 的个数以及这些 key 的 hash 的异或
+    for (i = 0; i < hashes.size(); i++) {
+        h = Mix(hashes[i]);
+
+        for (j = 0; j < 3; j++) {
+            slot = Index(h, j);
+            count[slot]++;
+            xormask[slot] ^= h;
+        }
+    }
+
+    for (i = 0; i < size; i++) {
+        if (count[i] == 1) {
+            queue.push_back(i);
+        }
+    }
+
+    stack.reserve(hashes.size());
+
+    while (!queue.empty()) {
+        i = queue.back();
+        queue.pop_back();
+
+        if (count[i] != 1) {
+            continue;
+        }
+
+        // 只剩一个 key 时异或的结果就是它的 hash
+        h = xormask[i];
+        stack.emplace_back(h, i);
+
+        for (j = 0; j < 3; j++) {
+            slot = Index(h, j);
+            count[slot]--;
+            xormask[slot] ^= h;
+
+            if (count[slot] == 1) {
+                queue.push_back(slot);
+            }
+        }
+    }
+
+    if (stack.size() != hashes.size()) {
+        return false;
+    }
+
+    std::fill(fingerprints_.begin(), fingerprints_.end(), 0);
+
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+        h = it->first;
+
+        fingerprints_[it->second] = static_cast<F>(h ^ (h >> 32))
+                                    ^ fingerprints_[Index(h, 0)]
+                                    ^ fingerprints_[Index(h, 1)]
+                                    ^ fingerprints_[Index(h, 2)];
+    }
+
+    return true;
+}
+
+
+template <typename F>
+bool
+XorFilter<F>::KeyMayMatch(const std::string &key) const
+{
+    const uint64_t  h = Mix(BloomHash64(key));
+    const F        *array = fingerprints_.data();
+
+    return static_cast<F>(h ^ (h >> 32))
+           == static_cast<F>(array[Index(h, 0)] ^ array[Index(h, 1)]
+                             ^ array[Index(h, 2)]);
+}
+
+
+template class XorFilter<uint8_t>;
+template class XorFilter<uint16_t>;
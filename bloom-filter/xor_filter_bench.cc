@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <xor_filter.hh>
+#include <bench_timer.hh>
+
+
+template <typename Filter>
+static void bench(const char *name, const Filter &filter, double build_ns,
+    const std::vector<std::string> &keys,
+    const std::vector<std::string> &absent);
+
+
+/*
+ * 在同样的误判率下比较 XOR Filter 与固定大小的 BloomFilter 的
+ * 内存、构建耗时和查询耗时
+ *
+ * usage: xor_filter_bench [#keys]
+ */
+int
+main(int argc, char **argv)
+{
+    size_t                    n, i;
+    double                    ns;
+    std::vector<std::string>  keys, absent;
+
+    n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000000;
+
+    keys.reserve(n);
+    absent.reserve(n);
+
+    for (i = 0; i < n; i++) {
+        keys.push_back("key-" + std::to_string(i));
+        absent.push_back("absent-" + std::to_string(i));
+    }
+
+    printf("%-14s %9s %9s %9s %10s %10s\n", "filter", "bits/key", "fpr%",
+           "build-ns", "hit-ns", "miss-ns");
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        Xor8Filter  filter(keys);
+        ns = elapsed_ns(start) / n;
+
+        bench("xor8", filter, ns, keys, absent);
+    }
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        BloomFilter  filter(n, 1.0 / 256, BloomFilter::kStandard,
+                            BloomFilter::kFastRange, BloomFilter::kHash64);
+        filter.Build(keys);
+        ns = elapsed_ns(start) / n;
+
+        bench("bloom 1/2^8", filter, ns, keys, absent);
+    }
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        Xor16Filter  filter(keys);
+        ns = elapsed_ns(start) / n;
+
+        bench("xor16", filter, ns, keys, absent);
+    }
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        BloomFilter  filter(n, 1.0 / 65536, BloomFilter::kStandard,
+                            BloomFilter::kFastRange, BloomFilter::kHash64);
+        filter.Build(keys);
+        ns = elapsed_ns(start) / n;
+
+        bench("bloom 1/2^16", filter, ns, keys, absent);
+    }
+
+    return 0;
+}
+
+
+template <typename Filter>
+static void
+bench(const char *name, const Filter &filter, double build_ns,
+    const std::vector<std::string> &keys,
+    const std::vector<std::string> &absent)
+{
+    size_t  i, j, fp, missing;
+    double  hit_ns, miss_ns;
+
+    // 按一个大素数跳着访问，避免顺序访问 key 带来的局部性
+    auto start = std::chrono::steady_clock::now();
+
+    missing = 0;
+    for (i = 0, j = 0; i < keys.size(); i++, j = (j + 7919) % keys.size()) {
+        missing += !filter.KeyMayMatch(keys[j]);
+    }
+
+    hit_ns = elapsed_ns(start) / keys.size();
+
+    if (missing) {
+        fprintf(stderr, "%s: %zu false negatives\n", name, missing);
+        exit(EXIT_FAILURE);
+    }
+
+    start = std::chrono::steady_clock::now();
+
+    fp = 0;
+    for (i = 0; i < absent.size(); i++) {
+        fp += filter.KeyMayMatch(absent[i]);
+    }
+
+    miss_ns = elapsed_ns(start) / absent.size();
+
+    printf("%-14s %9.2f %9.4f %9.1f %10.1f %10.1f\n", name,
+           filter.BitmapSize() * 8.0 / keys.size(),
+           100.0 * fp / absent.size(), build_ns, hit_ns, miss_ns);
+}
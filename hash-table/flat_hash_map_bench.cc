@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <flat_hash_map.hh>
+#include <bench_timer.hh>
+
+
+template <typename Map, typename Key>
+static void bench(const char *name, const std::vector<Key> &keys,
+    const std::vector<Key> &absent);
+
+
+/*
+ * 比较 FlatHashMap 与 std::unordered_map 的插入、命中查找、
+ * 未命中查找和删除，key 分别为 uint64_t 和 std::string，
+ * 元素个数从 10K 开始每次乘以 10，直到 max_keys
+ *
+ * usage: flat_hash_map_bench [max_keys]
+ */
+int
+main(int argc, char **argv)
+{
+    size_t                    n, max_keys, i;
+    std::mt19937_64           rng(20240601);
+    std::vector<uint64_t>     ints, absent_ints;
+    std::vector<std::string>  strs, absent_strs;
+
+    max_keys = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000000;
+
+    printf("%-22s %9s %9s %9s %9s %9s %9s\n", "map", "keys", "insert",
+           "reserved", "hit", "miss", "erase");
+
+    for (n = 10000; n <= max_keys; n *= 10) {
+        ints.clear();
+        absent_ints.clear();
+        strs.clear();
+        absent_strs.clear();
+
+        for (i = 0; i < n; i++) {
+            // 最低位区分存在与不存在的 key
+            ints.push_back(rng() << 1);
+            absent_ints.push_back((rng() << 1) | 1);
+
+            // 超过 15 字节，std::string 不能把它存放在对象内部
+            strs.push_back("user:session:" + std::to_string(ints.back()));
+            absent_strs.push_back("user:absent:" + std::to_string(i));
+        }
+
+        bench<std::unordered_map<uint64_t, uint64_t>>(
+            "unordered_map<u64>", ints, absent_ints);
+        bench<FlatHashMap<uint64_t, uint64_t>>(
+            "FlatHashMap<u64>", ints, absent_ints);
+        bench<std::unordered_map<std::string, uint64_t>>(
+            "unordered_map<string>", strs, absent_strs);
+        bench<FlatHashMap<std::string, uint64_t>>(
+            "FlatHashMap<string>", strs, absent_strs);
+    }
+
+    return 0;
+}
+
+
+/*
+ * 每一项都是每次操作的平均耗时(ns)，查找和删除按随机的顺序进行
+ */
+template <typename Map, typename Key>
+static void
+bench(const char *name, const std::vector<Key> &keys,
+    const std::vector<Key> &absent)
+{
+    size_t             i, found;
+    double             insert_ns, reserved_ns, hit_ns, miss_ns, erase_ns;
+    std::vector<Key>   shuffled(keys);
+
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(keys.size()));
+
+    {
+        Map  map;
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (i = 0; i < keys.size(); i++) {
+            map.insert(std::make_pair(keys[i], i));
+        }
+
+        insert_ns = elapsed_ns(start) / keys.size();
+    }
+
+    Map  map;
+
+    map.reserve(keys.size());
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (i = 0; i < keys.size(); i++) {
+        map.insert(std::make_pair(keys[i], i));
+    }
+
+    reserved_ns = elapsed_ns(start) / keys.size();
+
+    start = std::chrono::steady_clock::now();
+
+    found = 0;
+    for (i = 0; i < shuffled.size(); i++) {
+        found += map.find(shuffled[i]) != map.end();
+    }
+
+    hit_ns = elapsed_ns(start) / keys.size();
+
+    start = std::chrono::steady_clock::now();
+
+    for (i = 0; i < absent.size(); i++) {
+        found += map.find(absent[i]) != map.end();
+    }
+
+    miss_ns = elapsed_ns(start) / absent.size();
+
+    if (found != keys.size()) {
+        fprintf(stderr, "%s: found %zu of %zu\n", name, found, keys.size());
+        exit(EXIT_FAILURE);
+    }
+
+    start = std::chrono::steady_clock::now();
+
+    for (i = 0; i < shuffled.size(); i++) {
+        map.erase(shuffled[i]);
+    }
+
+    erase_ns = elapsed_ns(start) / keys.size();
+
+    if (!map.empty()) {
+        fprintf(stderr, "%s: %zu left after erase\n", name, map.size());
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%-22s %9zu %9.1f %9.1f %9.1f %9.1f %9.1f\n", name, keys.size(),
+           insert_ns, reserved_ns, hit_ns, miss_ns, erase_ns);
+}
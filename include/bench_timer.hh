@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#ifndef BENCH_TIMER_H__
+#define BENCH_TIMER_H__
+
+
+#include <chrono>
+
+
+/* 各个 bench 共用的计时函数，返回从 start 到现在经过的时间 */
+static inline double
+elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+
+static inline double
+elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+#endif /* BENCH_TIMER_H__ */
@@ -0,0 +1,479 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#ifndef BLOOM_FILTER_H__
+#define BLOOM_FILTER_H__
+
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <string>
+#include <vector>
+#include <hash.hh>
+
+
+static const size_t  kCacheLineSize = 64;
+
+
+/*
+ * 按 cache line 对齐分配内存，分块布局下每个块才能恰好占据一个 cache line
+ */
+template <typename T>
+class CacheLineAllocator
+{
+    public:
+        typedef T               value_type;
+        typedef std::true_type  is_always_equal;
+        typedef std::true_type  propagate_on_container_move_assignment;
+
+        CacheLineAllocator() = default;
+
+        template <typename U>
+        CacheLineAllocator(const CacheLineAllocator<U> &) {}
+
+        T *allocate(size_t n) {
+            void  *p;
+
+            if (posix_memalign(&p, kCacheLineSize, n * sizeof(T)) != 0) {
+                throw std::bad_alloc();
+            }
+
+            return static_cast<T *>(p);
+        }
+
+        void deallocate(T *p, size_t) {
+            free(p);
+        }
+};
+
+
+template <typename T, typename U>
+bool operator==(const CacheLineAllocator<T> &, const CacheLineAllocator<U> &)
+{
+    return true;
+}
+
+
+template <typename T, typename U>
+bool operator!=(const CacheLineAllocator<T> &, const CacheLineAllocator<U> &)
+{
+    return false;
+}
+
+
+static const uint32_t  kBloomHashSeed = 0xbc9f1d34;
+
+
+/* 前缀使用另一个种子，前缀不会与同样内容的 key 互相匹配 */
+static const uint32_t  kBloomPrefixSeed = 0x7a3c5e91;
+
+
+static inline uint32_t BloomHash(const Slice &key) {
+    return Hash(key, kBloomHashSeed);
+}
+
+
+static inline uint64_t BloomHash64(const Slice &key) {
+    return Hash64(key, kBloomHashSeed);
+}
+
+
+/*
+ * 研究表明 k = bits_per_key * ln(2) 时误判率低
+ */
+static inline size_t BloomNumProbes(double bits_per_key) {
+    size_t  k = static_cast<size_t>(bits_per_key * 0.69);
+
+    if (k < 1) {
+        k = 1;
+    }
+    if (k > 30) {
+        k = 30;
+    }
+
+    return k;
+}
+
+
+/*
+ * n 个 key 达到误判率 p 所需的最少位数为 m = -n * ln(p) / (ln2)^2
+ */
+static inline double BloomBitsPerKey(double fp_rate) {
+    return -log(fp_rate) / (M_LN2 * M_LN2);
+}
+
+
+class BloomFilter
+{
+    public:
+        enum Layout {
+            /* k 个探测位分散在整个位图上 */
+            kStandard,
+            /* 每个 key 只映射到一个 64 字节的块，k 个探测位都落在块内 */
+            kBlocked
+        };
+
+        /* 怎样把 hash 值映射到位图(或块)的范围内 */
+        enum Reduction {
+            /* h % n，每次探测都要做一次除法 */
+            kModulo,
+            /* 位图大小向上取整为 2 的幂，h & (n - 1) */
+            kPowerOfTwo,
+            /* Lemire 的 (h * n) >> 32，任意大小，只需一次乘法 */
+            kFastRange
+        };
+
+        /*
+         * 32 位的 hash 只能区分 2^32 个 key，key 达到上亿个时冲突
+         * 就会明显抬高误判率，位图超过 2^32 位时也无法均匀地访问到所有位
+         */
+        enum HashWidth {
+            kHash32,
+            kHash64
+        };
+
+        /* Map 之后怎样访问映射，决定给内核的 madvise 建议 */
+        enum Access {
+            /* 查询随机访问位图，关闭预读 */
+            kRandomAccess,
+            /* 从头到尾读一遍(比如合并)，加大预读 */
+            kSequentialAccess
+        };
+
+        /*
+         * 位图从 64 bits 开始按需扩大一倍，为了扩大时重新计算 hash，
+         * 需要保存所有添加过的 key。位图大小总是 2 的幂，所以用 kPowerOfTwo
+         */
+        explicit BloomFilter(int bits_per_key, Layout layout = kStandard,
+                             HashWidth hash_width = kHash32);
+
+        /*
+         * 按预计的 key 个数和误判率一次性分配好位图，之后不再扩大，
+         * 也不保存 key，添加的 key 超过 expected_keys 后误判率会变高
+         */
+        BloomFilter(size_t expected_keys, double fp_rate,
+                    Layout layout = kStandard,
+                    Reduction reduction = kFastRange,
+                    HashWidth hash_width = kHash32);
+
+        /*
+         * key 为 Slice，std::string、C 字符串和 (指针, 长度) 都可以直接传入，
+         * 固定大小的过滤器添加和查询都不会分配内存；可扩大的过滤器
+         * 需要保存 key，添加时仍要拷贝一份
+         */
+        void AddKey(const Slice &key);
+
+        /*
+         * 批量添加 key，结果与逐个 AddKey 相同，但位图只分配一次，
+         * hash 和置位由 nthreads 个线程并行完成，0 表示使用所有 CPU
+         */
+        void Build(const std::vector<std::string> &keys, size_t nthreads = 0);
+
+        bool KeyMayMatch(const Slice &key) const;
+
+        /*
+         * 除了 key 本身，还添加 key 在前 depth 个 delimiter 处截断得到的前缀
+         * (包含 delimiter)，例如 delimiter 为 '/'、depth 为 2 时，
+         * "tenant/table/row" 还会添加 "tenant/" 和 "tenant/table/"
+         *
+         * 必须在添加 key 之前设置，设置会随 Save 写入文件。
+         * 共同的前缀只占用一份位，但仍然会让实际的误判率略微升高
+         */
+        void SetPrefixPolicy(char delimiter, size_t depth);
+
+        /*
+         * 是否可能存在以 prefix 开头的 key，prefix 可以是任意字符串，
+         * 用它包含的最长的已添加前缀来判断，不包含任何已添加的前缀时
+         * (或者没有设置前缀)无法排除，返回 true
+         */
+        bool PrefixMayMatch(const Slice &prefix) const;
+
+        /*
+         * 是否可能存在落在 [start, end] 中的 key，范围内所有的 key
+         * 都以 start 和 end 的公共前缀开头
+         */
+        bool RangeMayMatch(const Slice &start, const Slice &end) const;
+
+        /*
+         * h 必须是 BloomHash(key) 的结果，便于多个过滤器共用一次 hash，
+         * 只能用于 kHash32 的过滤器；动态大小的过滤器只保存 h，
+         * 扩大位图时用它代替 key
+         */
+        void AddHash(uint32_t h);
+        bool HashMayMatch(uint32_t h) const;
+
+        /* 同上，h 为 BloomHash64(key)，只能用于 kHash64 的过滤器 */
+        void AddHash64(uint64_t h);
+        bool HashMayMatch64(uint64_t h) const;
+
+        /*
+         * 批量查询，result[i] 为 KeyMayMatch(keys[i]) 的结果
+         * 先批量计算 hash 并预取，CPU 支持 AVX2 时用 gather 指令同时探测 8 个 key
+         * (仅限 kHash32)
+         */
+        void KeyMayMatchBatch(const std::vector<std::string> &keys,
+                              std::vector<bool> &result) const;
+        void KeyMayMatchBatch(const std::vector<Slice> &keys,
+                              std::vector<bool> &result) const;
+
+        /*
+         * 与另一个过滤器按位或(并集)、按位与(交集)，结果与在同一个过滤器中
+         * 添加两边的 key(并集)相同；交集的误判率则高于只用共同的 key 构建的
+         * 过滤器。两者的位图大小、k、布局、映射方式和 hash 位数必须一致，
+         * 通常是用同样的参数构造的固定大小的过滤器
+         *
+         * 除了两个可扩大的过滤器求并集，结果都不能再扩大位图
+         *
+         * 失败时返回 false，不兼容时 errno 为 EINVAL，只读时为 EROFS
+         */
+        bool Union(const BloomFilter &other);
+        bool Intersect(const BloomFilter &other);
+        bool Compatible(const BloomFilter &other) const;
+
+        /*
+         * 将过滤器写入文件，格式见 bloom_filter_file.cc，
+         * 先写唯一命名的临时文件再 rename，正在 Map 该文件的进程不受影响，
+         * 返回前文件和所在目录都已 fsync
+         *
+         * 失败时返回 false，errno 指明原因
+         */
+        bool Save(const std::string &path) const;
+
+        /*
+         * 从 Save 写出的文件中读出过滤器，读出的过滤器不再保存 key，
+         * 所以之后也不会扩大位图
+         *
+         * 失败时返回 nullptr，errno 指明原因，文件格式不对时为 EINVAL
+         */
+        static std::unique_ptr<BloomFilter> Load(const std::string &path);
+
+        /*
+         * 只读地 mmap 文件，查询直接在映射上进行，多个进程共享 page cache，
+         * 不能再添加 key。校验和需要读完整个文件，所以默认不检查；
+         * 检查时读取期间总是按顺序访问处理，之后再按 access 设置
+         */
+        static std::unique_ptr<BloomFilter> Map(const std::string &path,
+                                                bool verify_checksum = false,
+                                                Access access = kRandomAccess);
+
+        size_t BitmapSize() const { return Size(); }
+        size_t NumProbes() const { return k_; }
+        size_t NumKeys() const { return num_keys_; }
+        HashWidth GetHashWidth() const { return hash_width_; }
+        bool ReadOnly() const { return mapping_ != nullptr; }
+
+        /* 位图以及为扩大位图而保存的 key 所占的内存 */
+        size_t ApproximateMemoryUsage() const;
+
+    private:
+        typedef std::vector<char, CacheLineAllocator<char>>  Bitmap;
+
+        /* 文件映射，拷贝过滤器时共享同一个映射 */
+        struct Mapping {
+            void    *addr;
+            size_t   length;
+
+            ~Mapping();
+        };
+
+        size_t                     bits_per_key_;
+        size_t                     k_;
+        Layout                     layout_;
+        Reduction                  reduction_;
+        HashWidth                  hash_width_;
+        Bitmap                     bitmap_;
+        bool                       fixed_;
+        size_t                     num_keys_;
+        std::vector<std::string>   keys_;
+        std::vector<uint32_t>      hashes_;
+        char                       prefix_delimiter_;
+        size_t                     prefix_depth_;
+
+        std::shared_ptr<Mapping>   mapping_;
+        const char                *map_data_;
+        size_t                     map_size_;
+
+        /* 供 Load 和 Map 使用，各字段由文件头填充 */
+        BloomFilter();
+
+        const char *Data() const {
+            return mapping_ ? map_data_ : bitmap_.data();
+        }
+
+        size_t Size() const {
+            return mapping_ ? map_size_ : bitmap_.size();
+        }
+
+        void Resize();
+        void Reserve();
+        bool Merge(const BloomFilter &other, bool intersect);
+        void AddKeysParallel(const std::vector<std::string> &keys,
+                             size_t nthreads);
+
+        /* 按 hash_width_ 计算 key 的 hash 并置位 */
+        template <bool kAtomic>
+        void SetKey(const Slice &key);
+
+        /* 返回 key 的前 depth 个 delimiter 之前(包含)的长度，没有时为 0 */
+        size_t PrefixLength(const Slice &key, size_t depth) const;
+        bool ProbePrefix(const Slice &prefix) const;
+
+        /* Key 为 std::string 或 Slice */
+        template <typename Key>
+        void KeyMayMatchBatchImpl(const std::vector<Key> &keys,
+                                  std::vector<bool> &result) const;
+
+        /* H 为 uint32_t 或 uint64_t，与 hash_width_ 对应 */
+        template <typename H>
+        size_t Reduce(H h, size_t n) const;
+
+        template <bool kAtomic, typename H>
+        void SetBits(H h);
+
+        template <bool kAtomic, Reduction R, typename H>
+        void SetBitsImpl(H h);
+
+        template <typename H>
+        bool Probe(H h) const;
+
+        template <Reduction R, typename H>
+        bool ProbeImpl(H h) const;
+};
+
+
+/*
+ * 以下是 BloomFilter 的映射和探测方式，基于 BloomHash 的其他过滤器
+ * 也使用它们，同样的 hash 才会得到同样的探测位置
+ */
+
+/* 分块布局下每个块的位数 */
+static const size_t  kBloomBlockBits = kCacheLineSize * 8;
+
+
+/*
+ * 双重 hash 的步长。32 位时沿用原来的循环移位；
+ * 64 位时用 MurmurHash3 的 fmix64 再混合一次，
+ * 与 h 一起相当于一个 128 位的 hash
+ */
+static inline uint32_t
+BloomProbeDelta(uint32_t h)
+{
+    return (h >> 17) | (h << 15);
+}
+
+
+static inline uint64_t
+BloomProbeDelta(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+
+/* 分块布局下块内探测用的 32 位种子 */
+static inline uint32_t
+BloomBlockSeed(uint32_t delta)
+{
+    return delta;
+}
+
+
+static inline uint32_t
+BloomBlockSeed(uint64_t delta)
+{
+    return static_cast<uint32_t>(delta >> 32);
+}
+
+
+/*
+ * 把 h 映射到 [0, n)
+ */
+template <BloomFilter::Reduction R>
+static inline size_t
+BloomReduce(uint32_t h, size_t n)
+{
+    switch (R) {
+
+    case BloomFilter::kPowerOfTwo:
+        return h & (n - 1);
+
+    case BloomFilter::kFastRange:
+        // n 超过 32 位时拆成高低两部分，结果与 h * n >> 32 相同
+        return ((uint64_t(h) * (n & 0xffffffff)) >> 32)
+               + uint64_t(h) * (n >> 32);
+
+    default:
+        return h % n;
+    }
+}
+
+
+template <BloomFilter::Reduction R>
+static inline size_t
+BloomReduce(uint64_t h, size_t n)
+{
+    switch (R) {
+
+    case BloomFilter::kPowerOfTwo:
+        return h & (n - 1);
+
+    case BloomFilter::kFastRange:
+        return (static_cast<unsigned __int128>(h) * n) >> 64;
+
+    default:
+        return h % n;
+    }
+}
+
+
+/*
+ * 依次用 k 个探测位的位置(位图共 nbits 位)调用 fn，fn 返回 false 时
+ * 停止并返回 false
+ *
+ * 标准布局每次探测加上 delta；分块布局先用 h 选出一个块，再用 delta
+ * 不断乘以黄金分割常数，每次取高 9 位作为块内的位置
+ */
+template <BloomFilter::Reduction R, typename H, typename Fn>
+static inline bool
+BloomProbe(H h, size_t k, bool blocked, size_t nbits, Fn fn)
+{
+    const H  delta = BloomProbeDelta(h);
+
+    if (blocked) {
+        const size_t  base = BloomReduce<R>(h, nbits / kBloomBlockBits)
+                             * kBloomBlockBits;
+        uint32_t      h2 = BloomBlockSeed(delta);
+
+        for (size_t i = 0; i < k; i++) {
+            h2 *= 0x9e3779b9;
+            if (!fn(base + (h2 >> 23))) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    for (size_t i = 0; i < k; i++) {
+        if (!fn(BloomReduce<R>(h, nbits))) {
+            return false;
+        }
+
+        h += delta;
+    }
+
+    return true;
+}
+
+
+#endif /* BLOOM_FILTER_H__ */
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#ifndef CONCURRENT_BLOOM_FILTER_H__
+#define CONCURRENT_BLOOM_FILTER_H__
+
+
+#include <atomic>
+#include <bloom_filter.hh>
+
+
+/*
+ * 固定大小、可以被多个线程同时插入和查询的 Bloom Filter
+ *
+ * 位图由 64 位原子整数组成，插入用 fetch_or 置位，查询直接读取，都不加锁。
+ * hash 方式与 BloomFilter 相同，位置用 fastrange 映射(与 BloomFilter 默认的
+ * kFastRange 一致)，位图的内存布局也与之一致。
+ * 与某个 AddKey 同时进行的 KeyMayMatch 可能看不到这个 key
+ */
+class ConcurrentBloomFilter
+{
+    public:
+        ConcurrentBloomFilter(size_t expected_keys, double fp_rate,
+                              BloomFilter::Layout layout
+                                  = BloomFilter::kStandard);
+
+        /*
+         * 返回 true 表示至少有一位是本次置上的，返回 false 表示 key 可能
+         * 已经存在。k 个位分别原子地置上，整体并不是原子的：两个线程同时
+         * 插入同一个 key 时可能都返回 true，所以只有单个线程插入、或者
+         * 同时插入的 key 互不相同时才能直接用来去重
+         */
+        bool AddKey(const std::string &key);
+        bool KeyMayMatch(const std::string &key) const;
+
+        bool AddHash(uint32_t h);
+        bool HashMayMatch(uint32_t h) const;
+
+        size_t BitmapSize() const { return nwords_ * sizeof(uint64_t); }
+        size_t NumProbes() const { return k_; }
+
+    private:
+        typedef std::atomic<uint64_t>  Word;
+
+        size_t                                      k_;
+        BloomFilter::Layout                         layout_;
+        size_t                                      nwords_;
+        std::vector<Word, CacheLineAllocator<Word>> words_;
+};
+
+
+#endif /* CONCURRENT_BLOOM_FILTER_H__ */
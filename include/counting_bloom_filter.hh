@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#ifndef COUNTING_BLOOM_FILTER_H__
+#define COUNTING_BLOOM_FILTER_H__
+
+
+#include <bloom_filter.hh>
+
+
+/*
+ * 支持删除的 Bloom Filter
+ *
+ * 每一位换成一个 4 位的计数器，一个字节存放两个，大小固定。
+ * 计数器加到 15 后不再变化，删除时也不减少，以免出现误删。
+ * hash 方式与 BloomFilter 的标准布局相同
+ */
+class CountingBloomFilter
+{
+    public:
+        CountingBloomFilter(size_t expected_keys, double fp_rate);
+
+        void AddKey(const std::string &key);
+
+        /*
+         * 只能删除确实添加过的 key，否则可能删掉其他 key
+         * 如果 key 一定不存在，返回 false 并且不做任何修改
+         */
+        bool RemoveKey(const std::string &key);
+
+        bool KeyMayMatch(const std::string &key) const;
+
+        size_t NumCounters() const { return counters_.size() * 2; }
+        size_t NumProbes() const { return k_; }
+
+    private:
+        size_t             k_;
+        std::vector<char>  counters_;
+
+        /* h 为 BloomHash(key)，RemoveKey 检查和删除共用一次 hash */
+        bool HashMayMatch(uint32_t h) const;
+
+        unsigned Counter(size_t i) const {
+            return (static_cast<unsigned char>(counters_[i / 2])
+                    >> ((i % 2) * 4)) & 0x0f;
+        }
+
+        void SetCounter(size_t i, unsigned value) {
+            const unsigned  shift = (i % 2) * 4;
+            unsigned char   byte = counters_[i / 2];
+
+            byte = (byte & ~(0x0f << shift)) | (value << shift);
+            counters_[i / 2] = byte;
+        }
+};
+
+
+#endif /* COUNTING_BLOOM_FILTER_H__ */
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#ifndef CUCKOO_FILTER_H__
+#define CUCKOO_FILTER_H__
+
+
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <bloom_filter.hh>
+
+
+/*
+ * Cuckoo Filter (Fan et al., 2014)
+ *
+ * 每个桶有 4 个槽，每个槽存放一个 F 类型的指纹，8 位指纹的桶是一个
+ * 32 位整数，16 位指纹的桶是一个 64 位整数。每个 key 只可能出现在两个
+ * 桶中，查询最多读两个 cache line，并且支持删除
+ *
+ * 桶的个数不必是 2 的幂，按 95% 的装载率分配，每个 key 约占
+ * 8 / 0.95 = 8.4 位或 16 / 0.95 = 16.8 位，误判率约为 8 / 2^(指纹位数)，
+ * 8 位时约 3.1%，16 位时约 0.012%
+ *
+ * F 为 uint8_t 或 uint16_t
+ */
+template <typename F>
+class CuckooFilter
+{
+    public:
+        explicit CuckooFilter(size_t expected_keys);
+
+        /* 过滤器已满时返回 false */
+        bool AddKey(const std::string &key);
+
+        /* 只能删除确实添加过的 key，key 不存在时返回 false */
+        bool RemoveKey(const std::string &key);
+
+        bool KeyMayMatch(const std::string &key) const;
+
+        size_t NumKeys() const { return num_keys_; }
+        size_t NumBuckets() const { return buckets_.size(); }
+        size_t BitmapSize() const { return buckets_.size() * sizeof(Bucket); }
+
+    private:
+        typedef typename std::conditional<sizeof(F) == 1, uint32_t,
+                                          uint64_t>::type          Bucket;
+        typedef std::vector<Bucket, CacheLineAllocator<Bucket>>  Buckets;
+
+        /* 踢出的指纹找不到位置时暂存在这里 */
+        struct Victim {
+            bool    used;
+            F       fingerprint;
+            size_t  index;
+        };
+
+        Buckets   buckets_;
+        size_t    num_keys_;
+        Victim    victim_;
+        uint32_t  rand_;
+
+        void Locate(const std::string &key, size_t *index,
+                    F *fingerprint) const;
+        size_t AltIndex(size_t index, F fingerprint) const;
+        bool InsertToBucket(size_t index, F fingerprint);
+        bool RemoveFromBucket(size_t index, F fingerprint);
+};
+
+
+typedef CuckooFilter<uint8_t>   Cuckoo8Filter;
+typedef CuckooFilter<uint16_t>  Cuckoo16Filter;
+
+
+#endif /* CUCKOO_FILTER_H__ */
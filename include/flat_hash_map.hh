@@ -0,0 +1,741 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#ifndef FLAT_HASH_MAP_H__
+#define FLAT_HASH_MAP_H__
+
+
+#include <stdint.h>
+#include <string.h>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <hash.hh>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+static const uint32_t  kFlatHashSeed = 0x8f1bbcdc;
+
+
+/*
+ * 默认的 hash 函数。字符串用 hash.hh 中的 Hash()，
+ * std::string、Slice 和 C 字符串都可以直接查找(heterogeneous lookup)，
+ * 不需要构造临时的 std::string
+ */
+template <typename K>
+struct FlatHash {
+    size_t operator()(const K &key) const {
+        return std::hash<K>()(key);
+    }
+};
+
+
+template <>
+struct FlatHash<std::string> {
+    typedef void  is_transparent;
+
+    size_t operator()(const Slice &key) const {
+        return Hash(key, kFlatHashSeed);
+    }
+};
+
+
+template <>
+struct FlatHash<Slice> : FlatHash<std::string> {};
+
+
+template <typename K>
+struct FlatEqual : std::equal_to<K> {};
+
+
+template <>
+struct FlatEqual<std::string> {
+    typedef void  is_transparent;
+
+    bool operator()(const Slice &x, const Slice &y) const {
+        return x == y;
+    }
+};
+
+
+template <>
+struct FlatEqual<Slice> : FlatEqual<std::string> {};
+
+
+/*
+ * 控制字节：空槽为 kEmpty，删除过的槽为 kDeleted，
+ * 使用中的槽为 hash 的低 7 位(H2)，最高位为 0
+ */
+static const int8_t  kFlatEmpty = -128;
+static const int8_t  kFlatDeleted = -2;
+
+
+#if defined(__SSE2__)
+
+/*
+ * 一组 16 个控制字节，一条指令就能与 H2 比较，
+ * 结果的第 i 位对应组内第 i 个槽
+ */
+class FlatGroup
+{
+    public:
+        static const size_t  kWidth = 16;
+
+        explicit FlatGroup(const int8_t *ctrl)
+            : ctrl_(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl))) {}
+
+        uint32_t Match(int8_t h2) const {
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl_, _mm_set1_epi8(h2)));
+        }
+
+        uint32_t MatchEmpty() const {
+            return Match(kFlatEmpty);
+        }
+
+        /* kEmpty 和 kDeleted 的最高位都是 1 */
+        uint32_t MatchEmptyOrDeleted() const {
+            return _mm_movemask_epi8(ctrl_);
+        }
+
+    private:
+        __m128i  ctrl_;
+};
+
+#else
+
+/*
+ * 没有 SSE2 时一组 8 个控制字节，逐个比较
+ */
+class FlatGroup
+{
+    public:
+        static const size_t  kWidth = 8;
+
+        explicit FlatGroup(const int8_t *ctrl) {
+            memcpy(ctrl_, ctrl, kWidth);
+        }
+
+        uint32_t Match(int8_t h2) const {
+            uint32_t  mask = 0;
+
+            for (size_t i = 0; i < kWidth; i++) {
+                mask |= uint32_t(ctrl_[i] == h2) << i;
+            }
+
+            return mask;
+        }
+
+        uint32_t MatchEmpty() const {
+            return Match(kFlatEmpty);
+        }
+
+        uint32_t MatchEmptyOrDeleted() const {
+            uint32_t  mask = 0;
+
+            for (size_t i = 0; i < kWidth; i++) {
+                mask |= uint32_t(ctrl_[i] < 0) << i;
+            }
+
+            return mask;
+        }
+
+    private:
+        int8_t  ctrl_[kWidth];
+};
+
+#endif
+
+
+/*
+ * 开放寻址的 hash 表 (Swiss Table)
+ *
+ * 元素直接存放在一个数组中，另有一个控制字节数组，每个槽一个字节。
+ * 查找时按组读出 16 个控制字节，用 SIMD 指令一次比较 H2，
+ * 只有 H2 相同的槽才需要比较 key，绝大多数不存在的 key
+ * 只需要读一次控制字节。容量为 2 的幂，最多装到 7/8
+ *
+ * 插入和扩容会使迭代器以及指向元素的指针失效
+ *
+ * Hasher 和 KeyEqual 都有 is_transparent 时(字符串的默认情形)，
+ * find/count/contains/erase 可以传入与 K 不同但可比较的类型
+ */
+template <typename K, typename V, typename Hasher = FlatHash<K>,
+          typename KeyEqual = FlatEqual<K>>
+class FlatHashMap
+{
+    private:
+        template <typename...>
+        struct VoidType {
+            typedef void  type;
+        };
+
+        /* Q 只是为了让结果依赖于查找的类型，这样才能 SFINAE */
+        template <typename H, typename Q, typename = void>
+        struct IsTransparent : std::false_type {};
+
+        template <typename H, typename Q>
+        struct IsTransparent<H, Q,
+            typename VoidType<typename H::is_transparent>::type>
+            : std::true_type {};
+
+        /* Hasher 和 KeyEqual 都透明时才接受与 K 不同的类型 */
+        template <typename Q>
+        using LookupKey = typename std::enable_if<
+            IsTransparent<Hasher, Q>::value
+            && IsTransparent<KeyEqual, Q>::value>::type;
+
+    public:
+        typedef K                       key_type;
+        typedef V                       mapped_type;
+        typedef std::pair<const K, V>   value_type;
+        typedef size_t                  size_type;
+
+        template <bool kConst>
+        class Iterator
+        {
+            public:
+                typedef std::forward_iterator_tag  iterator_category;
+                typedef FlatHashMap::value_type    value_type;
+                typedef ptrdiff_t                  difference_type;
+                typedef typename std::conditional<kConst, const value_type *,
+                                                  value_type *>::type  pointer;
+                typedef typename std::conditional<kConst, const value_type &,
+                                                  value_type &>::type  reference;
+
+                Iterator() : ctrl_(NULL), end_(NULL), slot_(NULL) {}
+
+                /* iterator 可以转换为 const_iterator */
+                template <bool kOther,
+                          typename = typename std::enable_if<kConst
+                                                             || !kOther>::type>
+                Iterator(const Iterator<kOther> &other)
+                    : ctrl_(other.ctrl_), end_(other.end_), slot_(other.slot_) {}
+
+                reference operator*() const { return *slot_; }
+                pointer operator->() const { return slot_; }
+
+                Iterator &operator++() {
+                    ctrl_++;
+                    slot_++;
+                    SkipEmpty();
+                    return *this;
+                }
+
+                Iterator operator++(int) {
+                    Iterator  tmp = *this;
+
+                    ++*this;
+                    return tmp;
+                }
+
+                friend bool operator==(const Iterator &x, const Iterator &y) {
+                    return x.slot_ == y.slot_;
+                }
+
+                friend bool operator!=(const Iterator &x, const Iterator &y) {
+                    return x.slot_ != y.slot_;
+                }
+
+            private:
+                friend class FlatHashMap;
+
+                template <bool>
+                friend class Iterator;
+
+                const int8_t  *ctrl_;
+                const int8_t  *end_;
+                value_type    *slot_;
+
+                Iterator(const int8_t *ctrl, const int8_t *end,
+                         value_type *slot)
+                    : ctrl_(ctrl), end_(end), slot_(slot) {}
+
+                void SkipEmpty() {
+                    while (ctrl_ < end_ && *ctrl_ < 0) {
+                        ctrl_++;
+                        slot_++;
+                    }
+                }
+        };
+
+        typedef Iterator<false>  iterator;
+        typedef Iterator<true>   const_iterator;
+
+        FlatHashMap() { InitEmpty(); }
+
+        explicit FlatHashMap(size_t n) {
+            InitEmpty();
+            reserve(n);
+        }
+
+        FlatHashMap(const FlatHashMap &other)
+            : hasher_(other.hasher_), eq_(other.eq_)
+        {
+            InitEmpty();
+            reserve(other.size());
+
+            for (const auto &value : other) {
+                try_emplace(value.first, value.second);
+            }
+        }
+
+        FlatHashMap(FlatHashMap &&other) noexcept
+            : hasher_(std::move(other.hasher_)), eq_(std::move(other.eq_))
+        {
+            InitEmpty();
+            Swap(other);
+        }
+
+        FlatHashMap &operator=(FlatHashMap other) {
+            Swap(other);
+            return *this;
+        }
+
+        ~FlatHashMap() {
+            Destroy();
+        }
+
+        iterator begin() {
+            iterator  it(ctrl_, ctrl_ + capacity_, slots_);
+
+            it.SkipEmpty();
+            return it;
+        }
+
+        iterator end() {
+            return iterator(ctrl_ + capacity_, ctrl_ + capacity_,
+                            slots_ + capacity_);
+        }
+
+        const_iterator begin() const {
+            return const_cast<FlatHashMap *>(this)->begin();
+        }
+
+        const_iterator end() const {
+            return const_cast<FlatHashMap *>(this)->end();
+        }
+
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        size_t capacity() const { return capacity_; }
+
+        void clear() {
+            Destroy();
+            InitEmpty();
+        }
+
+        /* 保证再插入到 n 个元素之前不会扩容 */
+        void reserve(size_t n) {
+            size_t  capacity = FlatGroup::kWidth;
+
+            while (MaxLoad(capacity) < n) {
+                capacity <<= 1;
+            }
+
+            if (capacity > capacity_) {
+                Rehash(capacity);
+            }
+        }
+
+        /* key 不存在时用 args 构造 value 并插入 */
+        template <typename... Args>
+        std::pair<iterator, bool> try_emplace(const K &key, Args&&... args) {
+            return EmplaceImpl(key, std::forward<Args>(args)...);
+        }
+
+        template <typename... Args>
+        std::pair<iterator, bool> try_emplace(K &&key, Args&&... args) {
+            return EmplaceImpl(std::move(key), std::forward<Args>(args)...);
+        }
+
+        std::pair<iterator, bool> insert(const value_type &value) {
+            return EmplaceImpl(value.first, value.second);
+        }
+
+        std::pair<iterator, bool> insert(value_type &&value) {
+            return EmplaceImpl(std::move(const_cast<K &>(value.first)),
+                               std::move(value.second));
+        }
+
+        V &operator[](const K &key) {
+            return try_emplace(key).first->second;
+        }
+
+        V &operator[](K &&key) {
+            return try_emplace(std::move(key)).first->second;
+        }
+
+        iterator find(const K &key) {
+            return FindImpl(key);
+        }
+
+        const_iterator find(const K &key) const {
+            return const_cast<FlatHashMap *>(this)->FindImpl(key);
+        }
+
+        bool contains(const K &key) const {
+            return FindIndex(key) != kNotFound;
+        }
+
+        size_t count(const K &key) const {
+            return FindIndex(key) != kNotFound;
+        }
+
+        size_t erase(const K &key) {
+            return EraseImpl(key);
+        }
+
+        /* Hasher 和 KeyEqual 透明时，Q 可以是任意能与 K 比较的类型 */
+        template <typename Q, typename = LookupKey<Q>>
+        iterator find(const Q &key) {
+            return FindImpl(key);
+        }
+
+        template <typename Q, typename = LookupKey<Q>>
+        const_iterator find(const Q &key) const {
+            return const_cast<FlatHashMap *>(this)->FindImpl(key);
+        }
+
+        template <typename Q, typename = LookupKey<Q>>
+        bool contains(const Q &key) const {
+            return FindIndex(key) != kNotFound;
+        }
+
+        template <typename Q, typename = LookupKey<Q>>
+        size_t count(const Q &key) const {
+            return FindIndex(key) != kNotFound;
+        }
+
+        template <typename Q, typename = LookupKey<Q>>
+        size_t erase(const Q &key) {
+            return EraseImpl(key);
+        }
+
+        /* 与 abseil 一样不返回下一个迭代器，++it 仍然有效 */
+        void erase(const_iterator it) {
+            EraseIndex(it.slot_ - slots_);
+        }
+
+        void erase(iterator it) {
+            EraseIndex(it.slot_ - slots_);
+        }
+
+    private:
+        static const size_t  kNotFound = static_cast<size_t>(-1);
+
+        int8_t      *ctrl_;
+        value_type  *slots_;
+        size_t       capacity_;
+        /* 空表时为 0，否则为 capacity_ - 1 */
+        size_t       mask_;
+        size_t       size_;
+        /* 还能插入多少个元素，删除留下的 kDeleted 不会归还 */
+        size_t       growth_left_;
+        Hasher       hasher_;
+        KeyEqual     eq_;
+
+        /*
+         * 空表的控制字节指向一组全为 kEmpty 的静态数组，
+         * 查找不需要判断表是否为空
+         */
+        static int8_t *EmptyGroup() {
+            static int8_t  group[FlatGroup::kWidth] = {
+                kFlatEmpty, kFlatEmpty, kFlatEmpty, kFlatEmpty,
+                kFlatEmpty, kFlatEmpty, kFlatEmpty, kFlatEmpty,
+                kFlatEmpty, kFlatEmpty, kFlatEmpty, kFlatEmpty,
+                kFlatEmpty, kFlatEmpty, kFlatEmpty, kFlatEmpty
+            };
+
+            return group;
+        }
+
+        static size_t MaxLoad(size_t capacity) {
+            return capacity - capacity / 8;
+        }
+
+        void InitEmpty() {
+            ctrl_ = EmptyGroup();
+            slots_ = NULL;
+            capacity_ = 0;
+            mask_ = 0;
+            size_ = 0;
+            growth_left_ = 0;
+        }
+
+        void Swap(FlatHashMap &other) {
+            std::swap(ctrl_, other.ctrl_);
+            std::swap(slots_, other.slots_);
+            std::swap(capacity_, other.capacity_);
+            std::swap(mask_, other.mask_);
+            std::swap(size_, other.size_);
+            std::swap(growth_left_, other.growth_left_);
+            std::swap(hasher_, other.hasher_);
+            std::swap(eq_, other.eq_);
+        }
+
+        void Destroy() {
+            if (capacity_ == 0) {
+                return;
+            }
+
+            for (size_t i = 0; i < capacity_; i++) {
+                if (ctrl_[i] >= 0) {
+                    slots_[i].~value_type();
+                }
+            }
+
+            ::operator delete(ctrl_);
+            ::operator delete(slots_);
+        }
+
+        iterator MakeIterator(size_t i) {
+            return iterator(ctrl_ + i, ctrl_ + capacity_, slots_ + i);
+        }
+
+        template <typename Q>
+        iterator FindImpl(const Q &key) {
+            const size_t  i = FindIndex(key);
+
+            return (i == kNotFound) ? end() : MakeIterator(i);
+        }
+
+        template <typename Q>
+        size_t EraseImpl(const Q &key) {
+            const size_t  i = FindIndex(key);
+
+            if (i == kNotFound) {
+                return 0;
+            }
+
+            EraseIndex(i);
+            return 1;
+        }
+
+        /*
+         * 乘以 2^64 / 黄金分割比再把高位折叠下来，
+         * 32 位的 Hash() 的每一位都能影响 H1 和 H2
+         */
+        static uint64_t Mix(size_t h) {
+            uint64_t  m = uint64_t(h) * 0x9e3779b97f4a7c15ULL;
+
+            return m ^ (m >> 32);
+        }
+
+        static int8_t H2(uint64_t h) {
+            return static_cast<int8_t>(h & 0x7f);
+        }
+
+        static size_t H1(uint64_t h) {
+            return static_cast<size_t>(h >> 7);
+        }
+
+        /*
+         * 控制字节数组的末尾多出一组，是开头一组的拷贝，
+         * 从任意位置读一整组都不需要回绕
+         */
+        void SetCtrl(size_t i, int8_t h2) {
+            ctrl_[i] = h2;
+
+            if (i < FlatGroup::kWidth) {
+                ctrl_[capacity_ + i] = h2;
+            }
+        }
+
+        /*
+         * 以组为单位做二次探测，第 i 次跳过 i 组，
+         * 容量为 2 的幂时能访问到所有的组
+         */
+        template <typename Q>
+        size_t FindIndex(const Q &key) const {
+            return FindIndex(key, Mix(hasher_(key)));
+        }
+
+        /* h 为 Mix(hasher_(key))，插入时算好的哈希值可以重复使用 */
+        template <typename Q>
+        size_t FindIndex(const Q &key, uint64_t h) const {
+            const size_t    mask = mask_;
+            const int8_t    h2 = H2(h);
+            size_t          pos = H1(h) & mask;
+            size_t          step = 0;
+
+            for ( ;; ) {
+                const FlatGroup  group(ctrl_ + pos);
+
+                for (uint32_t m = group.Match(h2); m != 0; m &= m - 1) {
+                    const size_t  i = (pos + __builtin_ctz(m)) & mask;
+
+                    if (eq_(slots_[i].first, key)) {
+                        return i;
+                    }
+                }
+
+                // 组内有空槽说明 key 不可能在后面
+                if (group.MatchEmpty() != 0) {
+                    return kNotFound;
+                }
+
+                step += FlatGroup::kWidth;
+                pos = (pos + step) & mask;
+            }
+        }
+
+        /* 第一个空的或者删除过的槽，表不能为空表 */
+        size_t FindFirstNonFull(uint64_t h) const {
+            const size_t  mask = mask_;
+            size_t        pos = H1(h) & mask;
+            size_t        step = 0;
+
+            for ( ;; ) {
+                const uint32_t  m = FlatGroup(ctrl_ + pos).MatchEmptyOrDeleted();
+
+                if (m != 0) {
+                    return (pos + __builtin_ctz(m)) & mask;
+                }
+
+                step += FlatGroup::kWidth;
+                pos = (pos + step) & mask;
+            }
+        }
+
+        template <typename Key, typename... Args>
+        std::pair<iterator, bool> EmplaceImpl(Key &&key, Args&&... args) {
+            const uint64_t  h = Mix(hasher_(key));
+            size_t          i = FindIndex(key, h);
+
+            if (i != kNotFound) {
+                return std::make_pair(MakeIterator(i), false);
+            }
+
+            if (capacity_ == 0) {
+                Grow();
+            }
+
+            i = FindFirstNonFull(h);
+
+            // 重复利用删除过的槽不占用 growth_left_
+            if (growth_left_ == 0 && ctrl_[i] != kFlatDeleted) {
+                Grow();
+                i = FindFirstNonFull(h);
+            }
+
+            new (&slots_[i]) value_type(std::piecewise_construct,
+                std::forward_as_tuple(std::forward<Key>(key)),
+                std::forward_as_tuple(std::forward<Args>(args)...));
+
+            if (ctrl_[i] == kFlatEmpty) {
+                growth_left_--;
+            }
+
+            SetCtrl(i, H2(h));
+            size_++;
+
+            return std::make_pair(MakeIterator(i), true);
+        }
+
+        /*
+         * 删除的槽前后连续的空槽加起来凑不满一组时，不可能有探测
+         * 因为这一组满了而越过它，可以直接标记为 kEmpty，否则只能标记为
+         * kDeleted，以免截断其他 key 的探测序列
+         */
+        void EraseIndex(size_t i) {
+            const size_t    width = FlatGroup::kWidth;
+            const size_t    before = (i - width) & mask_;
+            const uint32_t  empty_after = FlatGroup(ctrl_ + i).MatchEmpty();
+            const uint32_t  empty_before = FlatGroup(ctrl_ + before).MatchEmpty();
+            bool            never_full = false;
+
+            if (empty_before != 0 && empty_after != 0) {
+                const size_t  trailing = __builtin_ctz(empty_after);
+                const size_t  leading = __builtin_clz(empty_before)
+                                        - (32 - width);
+
+                never_full = trailing + leading < width;
+            }
+
+            slots_[i].~value_type();
+            size_--;
+
+            if (never_full) {
+                SetCtrl(i, kFlatEmpty);
+                growth_left_++;
+
+            } else {
+                SetCtrl(i, kFlatDeleted);
+            }
+        }
+
+        /* 删除留下的 kDeleted 很多时原地重建就能腾出空间，不必扩大 */
+        void Grow() {
+            if (capacity_ > 0 && size_ <= MaxLoad(capacity_) / 2) {
+                Rehash(capacity_);
+
+            } else {
+                Rehash(capacity_ == 0 ? FlatGroup::kWidth : capacity_ * 2);
+            }
+        }
+
+        void Rehash(size_t capacity) {
+            int8_t      *old_ctrl = ctrl_;
+            value_type  *old_slots = slots_;
+            const size_t  old_capacity = capacity_;
+
+            int8_t      *ctrl;
+            value_type  *slots;
+
+            /* 两块内存都分配成功之后才修改成员，失败时表保持原样 */
+            ctrl = static_cast<int8_t *>(
+                       ::operator new(capacity + FlatGroup::kWidth));
+
+            try {
+                slots = static_cast<value_type *>(
+                            ::operator new(capacity * sizeof(value_type)));
+
+            } catch (...) {
+                ::operator delete(ctrl);
+                throw;
+            }
+
+            memset(ctrl, kFlatEmpty, capacity + FlatGroup::kWidth);
+
+            ctrl_ = ctrl;
+            slots_ = slots;
+            capacity_ = capacity;
+            mask_ = capacity - 1;
+            growth_left_ = MaxLoad(capacity) - size_;
+
+            for (size_t i = 0; i < old_capacity; i++) {
+                if (old_ctrl[i] < 0) {
+                    continue;
+                }
+
+                const uint64_t  h = Mix(hasher_(old_slots[i].first));
+                const size_t    j = FindFirstNonFull(h);
+
+                /*
+                 * 与 abseil 一样，搬迁时把 key 当作可修改的对象移动，
+                 * 原来的元素马上就被销毁
+                 */
+                new (&slots_[j]) value_type(
+                    std::move(const_cast<K &>(old_slots[i].first)),
+                    std::move(old_slots[i].second));
+                old_slots[i].~value_type();
+
+                SetCtrl(j, H2(h));
+            }
+
+            if (old_capacity > 0) {
+                ::operator delete(old_ctrl);
+                ::operator delete(old_slots);
+            }
+        }
+};
+
+
+#endif /* FLAT_HASH_MAP_H__ */
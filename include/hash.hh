@@ -2,36 +2,72 @@
 #define HASH_H__
 
 
+#include <assert.h>
 #include <string>
 #include <string.h>
+#include <slice.hh>
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HASH_HAVE_SSE42  1
+#include <nmmintrin.h>
+#else
+#define HASH_HAVE_SSE42  0
+#endif
 
-static uint32_t DecodeFixed32(const char *ptr) {
-    uint32_t  result;
 
-    memcpy(&result, ptr, sizeof(result));
-    return result;
+/*
+ * 按小端序读出整数。memcpy 不能用于 constexpr 函数，所以逐个字节拼起来，
+ * GCC 和 Clang 会把它合并为一次读取，与 memcpy 一样快
+ *
+ * 以下的 Hash() 和 Hash64() 都是 constexpr 的，编译期已知的 key
+ * 可以在编译期算出 hash，用作 case 标号或者静态数组的下标：
+ *
+ *     switch (Hash(name, seed)) {
+ *     case Hash("content-type", seed):
+ *         ...
+ *     }
+ */
+static constexpr uint32_t DecodeFixed32(const char *ptr) {
+    return uint32_t(static_cast<unsigned char>(ptr[0]))
+           | (uint32_t(static_cast<unsigned char>(ptr[1])) << 8)
+           | (uint32_t(static_cast<unsigned char>(ptr[2])) << 16)
+           | (uint32_t(static_cast<unsigned char>(ptr[3])) << 24);
 }
 
 
-static uint32_t Hash(const std::string &key, uint32_t seed) {
-    const uint32_t  m = 0xc6a4a893;
+static constexpr uint64_t DecodeFixed64(const char *ptr) {
+    return uint64_t(DecodeFixed32(ptr))
+           | (uint64_t(DecodeFixed32(ptr + 4)) << 32);
+}
+
+
+static constexpr uint32_t  kHashM = 0xc6a4a893;
+static constexpr uint64_t  kHash64M = 0xc6a4a7935bd1e995ULL;
+
+
+/* Hash() 的一轮，处理 4 个字节 */
+static constexpr uint32_t HashRound(uint32_t h, uint32_t w) {
+    h += w;
+    h *= kHashM;
+    h ^= (h >> 16);
+
+    return h;
+}
+
+
+/* 处理剩下的数据，返回 Hash() 的最终结果 */
+static constexpr uint32_t HashFinish(uint32_t h, const char *data,
+    const char *limit)
+{
     const uint32_t  r = 24;
-    const char  *data = key.data();
-    const uint32_t  n = key.size();
-    const char  *limit = data + n;
-    uint32_t  h = seed ^ (n * m);
 
     /*
      * 每次取 4 个字节
      * 如果有多余，会在后面将其用上
      */
     while (data + 4 <= limit) {
-        uint32_t w = DecodeFixed32(data);
+        h = HashRound(h, DecodeFixed32(data));
         data += 4;
-        h += w;
-        h *= m;
-        h ^= (h >> 16);
     }
 
     switch (limit - data) {
@@ -45,7 +81,7 @@ static uint32_t Hash(const std::string &key, uint32_t seed) {
 
     case 1:
         h += static_cast<unsigned char>(data[0]);
-        h *= m;
+        h *= kHashM;
         h ^= (h >> r);
         break;
     }
@@ -54,4 +90,414 @@ static uint32_t Hash(const std::string &key, uint32_t seed) {
 }
 
 
+static constexpr uint32_t Hash(const char *data, size_t size,
+    uint32_t seed)
+{
+    const uint32_t  n = size;
+
+    return HashFinish(seed ^ (n * kHashM), data, data + size);
+}
+
+
+static constexpr uint32_t Hash(const Slice &key, uint32_t seed) {
+    return Hash(key.data(), key.size(), seed);
+}
+
+
+/* Hash64() 的一轮，处理 8 个字节 */
+static constexpr uint64_t Hash64Round(uint64_t h, uint64_t w) {
+    const int  r = 47;
+
+    w *= kHash64M;
+    w ^= (w >> r);
+    w *= kHash64M;
+    h ^= w;
+    h *= kHash64M;
+
+    return h;
+}
+
+
+static constexpr uint64_t Hash64Finish(uint64_t h, const char *data,
+    const char *limit)
+{
+    const int  r = 47;
+
+    while (data + 8 <= limit) {
+        h = Hash64Round(h, DecodeFixed64(data));
+        data += 8;
+    }
+
+    switch (limit - data) {
+    case 7:
+        h ^= uint64_t(static_cast<unsigned char>(data[6])) << 48;
+        /* fall through */
+
+    case 6:
+        h ^= uint64_t(static_cast<unsigned char>(data[5])) << 40;
+        /* fall through */
+
+    case 5:
+        h ^= uint64_t(static_cast<unsigned char>(data[4])) << 32;
+        /* fall through */
+
+    case 4:
+        h ^= uint64_t(static_cast<unsigned char>(data[3])) << 24;
+        /* fall through */
+
+    case 3:
+        h ^= uint64_t(static_cast<unsigned char>(data[2])) << 16;
+        /* fall through */
+
+    case 2:
+        h ^= uint64_t(static_cast<unsigned char>(data[1])) << 8;
+        /* fall through */
+
+    case 1:
+        h ^= uint64_t(static_cast<unsigned char>(data[0]));
+        h *= kHash64M;
+        break;
+    }
+
+    h ^= (h >> r);
+    h *= kHash64M;
+    h ^= (h >> r);
+
+    return h;
+}
+
+
+/*
+ * 64 位的 hash (MurmurHash64A)，每次取 8 个字节，
+ * 数据量很大时 32 位的 hash 冲突太多，用这个
+ */
+static constexpr uint64_t Hash64(const char *data, size_t size,
+    uint64_t seed)
+{
+    const uint64_t  n = size;
+
+    return Hash64Finish(seed ^ (n * kHash64M), data, data + size);
+}
+
+
+static constexpr uint64_t Hash64(const Slice &key, uint64_t seed) {
+    return Hash64(key.data(), key.size(), seed);
+}
+
+
+/*
+ * 分段计算 Hash()，多次 Update 的数据连起来之后 Final 的结果
+ * 与一次 Hash() 相同，key 分散在多个缓冲区(例如 ngx_chain_t 或环形缓冲区)
+ * 时不需要先拷贝到一起
+ *
+ * Hash() 的初始值混入了 key 的长度，所以 Init 时必须给出总长度，
+ * 各次 Update 的长度之和必须等于它
+ */
+class Hasher
+{
+    public:
+        Hasher() { Init(0, 0); }
+        Hasher(uint32_t seed, size_t length) { Init(seed, length); }
+
+        void Init(uint32_t seed, size_t length) {
+            h_ = seed ^ (static_cast<uint32_t>(length) * kHashM);
+            remaining_ = length;
+            buffered_ = 0;
+        }
+
+        void Update(const char *data, size_t size) {
+            assert(size <= remaining_);
+            remaining_ -= size;
+
+            // 先把上次剩下的不足 4 个字节补齐
+            if (buffered_ > 0) {
+                while (buffered_ < 4 && size > 0) {
+                    buf_[buffered_++] = *data++;
+                    size--;
+                }
+
+                if (buffered_ < 4) {
+                    return;
+                }
+
+                h_ = HashRound(h_, DecodeFixed32(buf_));
+                buffered_ = 0;
+            }
+
+            for (/* void */; size >= 4; data += 4, size -= 4) {
+                h_ = HashRound(h_, DecodeFixed32(data));
+            }
+
+            memcpy(buf_, data, size);
+            buffered_ = size;
+        }
+
+        void Update(const Slice &data) { Update(data.data(), data.size()); }
+
+        uint32_t Final() const {
+            assert(remaining_ == 0);
+            return HashFinish(h_, buf_, buf_ + buffered_);
+        }
+
+    private:
+        uint32_t  h_;
+        size_t    remaining_;
+        size_t    buffered_;
+        char      buf_[4];
+};
+
+
+/* 同上，结果与 Hash64() 相同 */
+class Hasher64
+{
+    public:
+        Hasher64() { Init(0, 0); }
+        Hasher64(uint64_t seed, size_t length) { Init(seed, length); }
+
+        void Init(uint64_t seed, size_t length) {
+            h_ = seed ^ (static_cast<uint64_t>(length) * kHash64M);
+            remaining_ = length;
+            buffered_ = 0;
+        }
+
+        void Update(const char *data, size_t size) {
+            assert(size <= remaining_);
+            remaining_ -= size;
+
+            if (buffered_ > 0) {
+                while (buffered_ < 8 && size > 0) {
+                    buf_[buffered_++] = *data++;
+                    size--;
+                }
+
+                if (buffered_ < 8) {
+                    return;
+                }
+
+                h_ = Hash64Round(h_, DecodeFixed64(buf_));
+                buffered_ = 0;
+            }
+
+            for (/* void */; size >= 8; data += 8, size -= 8) {
+                h_ = Hash64Round(h_, DecodeFixed64(data));
+            }
+
+            memcpy(buf_, data, size);
+            buffered_ = size;
+        }
+
+        void Update(const Slice &data) { Update(data.data(), data.size()); }
+
+        uint64_t Final() const {
+            assert(remaining_ == 0);
+            return Hash64Finish(h_, buf_, buf_ + buffered_);
+        }
+
+    private:
+        uint64_t  h_;
+        size_t    remaining_;
+        size_t    buffered_;
+        char      buf_[8];
+};
+
+
+/*
+ * 同时计算 4 个 key 的 hash，out[i] 与 Hash(keys[i], seed) 相同
+ *
+ * 单个 key 的每一轮都依赖上一轮的结果，乘法的延迟无法被掩盖；
+ * 4 个 key 交替计算时互不依赖，CPU 可以同时执行。
+ * 4 个 key 都还有完整的一轮时一起计算，剩下的部分逐个完成
+ *
+ * Key 为 std::string 或 Slice
+ */
+template <typename Key>
+static void HashBatch(const Key *keys, size_t n, uint32_t seed,
+    uint32_t *out)
+{
+    size_t  i, j, k, rounds;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        const char  *data[4];
+        uint32_t     h[4];
+
+        rounds = keys[i].size() / 4;
+
+        for (j = 0; j < 4; j++) {
+            const uint32_t  len = keys[i + j].size();
+
+            data[j] = keys[i + j].data();
+            h[j] = seed ^ (len * kHashM);
+
+            if (len / 4 < rounds) {
+                rounds = len / 4;
+            }
+        }
+
+        for (k = 0; k < rounds; k++) {
+            for (j = 0; j < 4; j++) {
+                h[j] = HashRound(h[j], DecodeFixed32(data[j] + k * 4));
+            }
+        }
+
+        for (j = 0; j < 4; j++) {
+            out[i + j] = HashFinish(h[j], data[j] + rounds * 4,
+                                    keys[i + j].data() + keys[i + j].size());
+        }
+    }
+
+    for (/* void */; i < n; i++) {
+        out[i] = Hash(keys[i], seed);
+    }
+}
+
+
+/* 同上，out[i] 与 Hash64(keys[i], seed) 相同 */
+template <typename Key>
+static void Hash64Batch(const Key *keys, size_t n, uint64_t seed,
+    uint64_t *out)
+{
+    size_t  i, j, k, rounds;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        const char  *data[4];
+        uint64_t     h[4];
+
+        rounds = keys[i].size() / 8;
+
+        for (j = 0; j < 4; j++) {
+            const uint64_t  len = keys[i + j].size();
+
+            data[j] = keys[i + j].data();
+            h[j] = seed ^ (len * kHash64M);
+
+            if (len / 8 < rounds) {
+                rounds = len / 8;
+            }
+        }
+
+        for (k = 0; k < rounds; k++) {
+            for (j = 0; j < 4; j++) {
+                h[j] = Hash64Round(h[j], DecodeFixed64(data[j] + k * 8));
+            }
+        }
+
+        for (j = 0; j < 4; j++) {
+            out[i + j] = Hash64Finish(h[j], data[j] + rounds * 8,
+                                      keys[i + j].data() + keys[i + j].size());
+        }
+    }
+
+    for (/* void */; i < n; i++) {
+        out[i] = Hash64(keys[i], seed);
+    }
+}
+
+
+/*
+ * CRC32C (Castagnoli)，CPU 支持 SSE4.2 时使用 crc32 指令，每次 8 个字节，
+ * 否则查表，每次 1 个字节
+ */
+struct Crc32cTable {
+    uint32_t  entries[256];
+
+    Crc32cTable() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t  crc = i;
+
+            for (int j = 0; j < 8; j++) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0x82f63b78 : crc >> 1;
+            }
+
+            entries[i] = crc;
+        }
+    }
+};
+
+
+static inline uint32_t Crc32cSoftware(uint32_t crc, const char *data,
+    size_t n)
+{
+    static const Crc32cTable  table;
+
+    for (size_t i = 0; i < n; i++) {
+        crc = table.entries[(crc ^ static_cast<unsigned char>(data[i])) & 0xff]
+              ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+
+#if HASH_HAVE_SSE42
+
+__attribute__((target("sse4.2")))
+static inline uint32_t Crc32cHardware(uint32_t crc, const char *data,
+    size_t n)
+{
+    uint64_t  crc64 = crc;
+
+    for (/* void */; n >= 8; data += 8, n -= 8) {
+        crc64 = _mm_crc32_u64(crc64, DecodeFixed64(data));
+    }
+
+    crc = static_cast<uint32_t>(crc64);
+
+    if (n >= 4) {
+        crc = _mm_crc32_u32(crc, DecodeFixed32(data));
+        data += 4;
+        n -= 4;
+    }
+
+    for (/* void */; n > 0; data++, n--) {
+        crc = _mm_crc32_u8(crc, static_cast<unsigned char>(*data));
+    }
+
+    return crc;
+}
+
+
+static inline bool CpuHasSse42() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}
+
+#endif /* HASH_HAVE_SSE42 */
+
+
+/*
+ * 标准的 CRC32C，seed 为 0 时与其他实现的结果相同，
+ * 可以用 seed 传入上一段数据的结果，分段计算
+ */
+static inline uint32_t Crc32c(const Slice &key, uint32_t seed) {
+    uint32_t  crc = ~seed;
+
+#if HASH_HAVE_SSE42
+    static const bool  has_sse42 = CpuHasSse42();
+
+    if (has_sse42) {
+        return ~Crc32cHardware(crc, key.data(), key.size());
+    }
+#endif
+
+    return ~Crc32cSoftware(crc, key.data(), key.size());
+}
+
+
+/*
+ * CRC 是线性的，相近的 key 得到的结果在低位上很相似，
+ * 用 MurmurHash3 的 fmix32 打散之后再用于过滤器或 hash 表
+ */
+static inline uint32_t HashCrc32c(const Slice &key, uint32_t seed) {
+    uint32_t  h = Crc32c(key, seed);
+
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+
+    return h;
+}
+
+
 #endif /* HASH_H__ */
@@ -1,4 +1,3 @@
-
 /*
  * Copyright (C) Jianyong Chen
  */
@@ -7,19 +6,1026 @@
 #define QUICK_SORT_H__
 
 
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
 #include <vector>
+#include <work_stealing_pool.hh>
 
 
+/*
+ * 快速排序：三数取中选择枢纽元，小于等于 kInsertionCutoff 个元素的区间
+ * 改用插入排序
+ *
+ * 模板版本接受任意随机访问迭代器和比较函数(与 std::sort 的要求相同)，
+ * 比较在每种元素类型上都可以被内联
+ *
+ * kIntrosort(默认)在递归超过 2 * log2(n) 层之后改用堆排序，最坏情况为
+ * O(n log n)；kClassic 是不限深度的快速排序，精心构造的输入(如 organ-pipe)
+ * 会使它退化到 O(n^2)。所有模式都只递归较小的一半，栈深度不超过 log2(n)
+ *
+ * kPdq 是 pattern-defeating quicksort (Orson Peters, 2021)：
+ *   - 整体有序或逆序的输入 O(n) 完成，划分时没有交换的区间尝试直接
+ *     用插入排序收尾，基本有序的输入接近线性
+ *   - 枢纽元与左边界外的元素相等时，把等于枢纽元的元素都划分到左边
+ *     并且不再处理，重复元素很多时每个值只参与一次划分
+ *   - 算术类型配合 std::less/std::greater 时使用 BlockQuicksort 的分块
+ *     划分，比较结果只用来计算下标，消除了分支预测失败
+ *   - 划分极不均匀时打乱部分元素破坏输入的模式，次数过多则改用堆排序
+ *
+ * 指定线程池时并行排序：超过 kParallelCutoff 个元素的区间划分之后，
+ * 较小的一半作为任务交给线程池，较大的一半继续划分；超过
+ * kParallelPartitionCutoff 个元素的区间(最上面几层)在多于一个线程时
+ * 把划分本身也分块并行执行。不大于 kParallelCutoff 的区间按 mode 顺序排序。比较函数
+ * 会被多个线程同时调用，元素类型需要可以复制
+ */
 class QuickSorter
 {
     public:
+        enum Mode {
+            kClassic,
+            kIntrosort,
+            kPdq,
+        };
+
+        explicit QuickSorter(Mode mode = kIntrosort,
+                             WorkStealingPool *pool = nullptr)
+            : mode_(mode), pool_(pool) {}
+
         void Sort(std::vector<int> &);
 
+        template <typename RandomIt, typename Compare>
+        void Sort(RandomIt first, RandomIt last, Compare comp) const;
+
+        template <typename RandomIt>
+        void Sort(RandomIt first, RandomIt last) const {
+            Sort(first, last, std::less<>());
+        }
+
     private:
-        void sort(std::vector<int> &, int, int);
-        void insertion_sort(std::vector<int> &, int, int);
-        int median3(std::vector<int> &, int, int);
+        static const int  kInsertionCutoff = 10;
+
+        Mode               mode_;
+        WorkStealingPool  *pool_;
+
+        template <typename RandomIt, typename Compare>
+        void sequential_sort(RandomIt first, RandomIt last,
+            Compare &comp) const;
+
+        template <typename RandomIt, typename Compare>
+        static void sort(RandomIt first, RandomIt last, size_t depth_limit,
+            Compare &comp);
+
+        template <typename RandomIt, typename Compare>
+        static RandomIt partition(RandomIt first, RandomIt last,
+            Compare &comp);
+
+        template <typename RandomIt, typename Compare>
+        static void insertion_sort(RandomIt first, RandomIt last,
+            Compare &comp);
+
+        template <typename RandomIt, typename Compare>
+        static RandomIt median3(RandomIt first, RandomIt last, Compare &comp);
+
+        static const int  kPdqInsertionCutoff = 24;
+        static const int  kPdqNintherThreshold = 128;
+        static const int  kPdqPartialInsertionLimit = 8;
+        static const int  kPdqBlockSize = 64;
+
+        /* 只有比较代价很低时分块划分才划算 */
+        template <typename T, typename Compare>
+        static constexpr bool branchless() {
+            return std::is_arithmetic<T>::value
+                   && (std::is_same<Compare, std::less<T>>::value
+                       || std::is_same<Compare, std::greater<T>>::value
+                       || std::is_same<Compare, std::less<>>::value
+                       || std::is_same<Compare, std::greater<>>::value);
+        }
+
+        template <bool Branchless, typename RandomIt, typename Compare>
+        static void pdq_sort(RandomIt first, RandomIt last, Compare &comp);
+
+        template <bool Branchless, typename RandomIt, typename Compare>
+        static void pdq_loop(RandomIt first, RandomIt last, int bad_allowed,
+            bool leftmost, Compare &comp);
+
+        template <typename RandomIt, typename Compare>
+        static std::pair<RandomIt, bool> partition_right(RandomIt first,
+            RandomIt last, Compare &comp);
+
+        template <typename RandomIt, typename Compare>
+        static std::pair<RandomIt, bool> partition_right_branchless(
+            RandomIt first, RandomIt last, Compare &comp);
+
+        template <typename RandomIt, typename Compare>
+        static RandomIt partition_left(RandomIt first, RandomIt last,
+            Compare &comp);
+
+        template <typename RandomIt>
+        static void swap_offsets(RandomIt first, RandomIt last,
+            const unsigned char *offsets_l, const unsigned char *offsets_r,
+            size_t num, bool use_swaps);
+
+        template <typename RandomIt, typename Compare>
+        static void unguarded_insertion_sort(RandomIt first, RandomIt last,
+            Compare &comp);
+
+        template <typename RandomIt, typename Compare>
+        static bool partial_insertion_sort(RandomIt first, RandomIt last,
+            Compare &comp);
+
+        template <typename RandomIt, typename Compare>
+        static void sort3(RandomIt a, RandomIt b, RandomIt c, Compare &comp);
+
+        static const ptrdiff_t  kParallelCutoff = 1 << 15;
+        static const ptrdiff_t  kParallelPartitionCutoff = 1 << 20;
+
+        template <typename RandomIt, typename Compare>
+        void parallel_sort(RandomIt first, RandomIt last, size_t depth_limit,
+            Compare comp) const;
+
+        template <typename RandomIt, typename Compare>
+        void split(RandomIt first, RandomIt last, RandomIt *lower,
+            RandomIt *upper, Compare &comp) const;
+
+        template <typename RandomIt, typename Compare>
+        void parallel_split(RandomIt first, RandomIt last, RandomIt *lower,
+            RandomIt *upper, Compare &comp) const;
+
+        template <typename RandomIt, typename Predicate>
+        RandomIt parallel_partition(RandomIt first, RandomIt last,
+            Predicate pred) const;
 };
 
 
+template <typename RandomIt, typename Compare>
+inline void
+QuickSorter::Sort(RandomIt first, RandomIt last, Compare comp) const
+{
+    size_t  n, depth_limit;
+
+    if (pool_ != nullptr && last - first > kParallelCutoff) {
+        depth_limit = 0;
+        for (n = last - first; n > 1; n >>= 1) {
+            depth_limit += 2;
+        }
+
+        parallel_sort(first, last, depth_limit, comp);
+        return;
+    }
+
+    sequential_sort(first, last, comp);
+}
+
+
+template <typename RandomIt, typename Compare>
+void
+QuickSorter::sequential_sort(RandomIt first, RandomIt last,
+    Compare &comp) const
+{
+    typedef typename std::iterator_traits<RandomIt>::value_type  T;
+
+    size_t  n, depth_limit;
+
+    if (mode_ == kPdq) {
+        pdq_sort<branchless<T, Compare>()>(first, last, comp);
+        return;
+    }
+
+    depth_limit = SIZE_MAX;
+
+    if (mode_ == kIntrosort) {
+        depth_limit = 0;
+        for (n = last - first; n > 1; n >>= 1) {
+            depth_limit += 2;
+        }
+    }
+
+    sort(first, last, depth_limit, comp);
+}
+
+
+/*
+ * 对 [first, last) 排序，划分的层数超过 depth_limit 之后改用堆排序；
+ * 较小的一半递归处理，较大的一半在循环里继续划分
+ */
+template <typename RandomIt, typename Compare>
+void
+QuickSorter::sort(RandomIt first, RandomIt last, size_t depth_limit,
+    Compare &comp)
+{
+    RandomIt  middle;
+
+    while (last - first > kInsertionCutoff) {
+
+        if (depth_limit == 0) {
+            std::make_heap(first, last, comp);
+            std::sort_heap(first, last, comp);
+            return;
+        }
+
+        depth_limit--;
+        middle = partition(first, last, comp);
+
+        if (middle - first < last - middle) {
+            sort(first, middle, depth_limit, comp);
+            first = middle + 1;
+
+        } else {
+            sort(middle + 1, last, depth_limit, comp);
+            last = middle;
+        }
+    }
+
+    insertion_sort(first, last, comp);
+}
+
+
+/*
+ * 以三数中值为枢纽元划分 [first, last)，返回枢纽元最终的位置
+ */
+template <typename RandomIt, typename Compare>
+RandomIt
+QuickSorter::partition(RandomIt first, RandomIt last, Compare &comp)
+{
+    RandomIt  pivot = median3(first, last, comp);
+    RandomIt  i = first, j = pivot;
+
+    /*
+     * *first 不大于枢纽元，枢纽元本身在 pivot 处，它们分别是两个扫描的
+     * 哨兵；与枢纽元相等的元素两边都停下来交换，重复元素较多时划分仍然均匀
+     */
+    for ( ;; ) {
+        while (comp(*++i, *pivot)) {  }
+        while (comp(*pivot, *--j)) {  }
+
+        if (i < j) {
+            std::iter_swap(i, j);
+
+        } else {
+            break;
+        }
+    }
+
+    std::iter_swap(i, pivot);
+    return i;
+}
+
+
+/*
+ * 把 first、中间和 last - 1 三个元素排好序，中值放到 last - 2 处
+ * 作为枢纽元，返回它的位置
+ */
+template <typename RandomIt, typename Compare>
+RandomIt
+QuickSorter::median3(RandomIt first, RandomIt last, Compare &comp)
+{
+    RandomIt  center = first + (last - first - 1) / 2;
+    RandomIt  right = last - 1;
+
+    if (comp(*right, *first)) {
+        std::iter_swap(first, right);
+    }
+
+    if (comp(*center, *first)) {
+        std::iter_swap(first, center);
+    }
+
+    if (comp(*right, *center)) {
+        std::iter_swap(center, right);
+    }
+
+    std::iter_swap(center, right - 1);
+    return right - 1;
+}
+
+
+template <typename RandomIt, typename Compare>
+void
+QuickSorter::insertion_sort(RandomIt first, RandomIt last, Compare &comp)
+{
+    RandomIt  i, j;
+
+    if (first == last) {
+        return;
+    }
+
+    for (i = first + 1; i != last; i++) {
+        auto  value = std::move(*i);
+
+        for (j = i; j != first && comp(value, *(j - 1)); j--) {
+            *j = std::move(*(j - 1));
+        }
+
+        *j = std::move(value);
+    }
+}
+
+
+/*
+ * 先检查整个区间是否已经有序或逆序(随机输入通常两三次比较就能排除)，
+ * 然后进入 pdqsort 的主循环，允许出现 log2(n) 次极不均匀的划分
+ */
+template <bool Branchless, typename RandomIt, typename Compare>
+void
+QuickSorter::pdq_sort(RandomIt first, RandomIt last, Compare &comp)
+{
+    int       bad_allowed;
+    size_t    n;
+    RandomIt  i;
+
+    if (last - first < 2) {
+        return;
+    }
+
+    i = first + 1;
+
+    if (comp(*i, *first)) {
+        while (i != last && !comp(*(i - 1), *i)) {
+            i++;
+        }
+
+        if (i == last) {
+            std::reverse(first, last);
+            return;
+        }
+
+    } else {
+        while (i != last && !comp(*i, *(i - 1))) {
+            i++;
+        }
+
+        if (i == last) {
+            return;
+        }
+    }
+
+    bad_allowed = 0;
+    for (n = last - first; n > 1; n >>= 1) {
+        bad_allowed++;
+    }
+
+    pdq_loop<Branchless>(first, last, bad_allowed, true, comp);
+}
+
+
+/*
+ * leftmost 为 false 时 *(first - 1) 不大于区间内的任何元素，
+ * 可以作为插入排序和 partition_left 的哨兵
+ */
+template <bool Branchless, typename RandomIt, typename Compare>
+void
+QuickSorter::pdq_loop(RandomIt first, RandomIt last, int bad_allowed,
+    bool leftmost, Compare &comp)
+{
+    bool                                   already_partitioned;
+    RandomIt                               pivot;
+    std::pair<RandomIt, bool>              part;
+    typename std::iterator_traits<RandomIt>::difference_type  n, half, l, r;
+
+    for ( ;; ) {
+        n = last - first;
+
+        if (n < kPdqInsertionCutoff) {
+            if (leftmost) {
+                insertion_sort(first, last, comp);
+
+            } else {
+                unguarded_insertion_sort(first, last, comp);
+            }
+
+            return;
+        }
+
+        /* 枢纽元放在 *first，大区间用 ninther(三组三数中值的中值) */
+        half = n / 2;
+
+        if (n > kPdqNintherThreshold) {
+            sort3(first, first + half, last - 1, comp);
+            sort3(first + 1, first + (half - 1), last - 2, comp);
+            sort3(first + 2, first + (half + 1), last - 3, comp);
+            sort3(first + (half - 1), first + half, first + (half + 1), comp);
+            std::iter_swap(first, first + half);
+
+        } else {
+            sort3(first + half, first, last - 1, comp);
+        }
+
+        /*
+         * 枢纽元等于左边界外的元素，说明区间里没有比它小的元素，
+         * 等于它的元素都归到左边之后就已经在最终的位置上了
+         */
+        if (!leftmost && !comp(*(first - 1), *first)) {
+            first = partition_left(first, last, comp) + 1;
+            continue;
+        }
+
+        part = Branchless ? partition_right_branchless(first, last, comp)
+                          : partition_right(first, last, comp);
+        pivot = part.first;
+        already_partitioned = part.second;
+
+        l = pivot - first;
+        r = last - (pivot + 1);
+
+        if (l < n / 8 || r < n / 8) {
+            if (--bad_allowed == 0) {
+                std::make_heap(first, last, comp);
+                std::sort_heap(first, last, comp);
+                return;
+            }
+
+            if (l >= kPdqInsertionCutoff) {
+                std::iter_swap(first, first + l / 4);
+                std::iter_swap(pivot - 1, pivot - l / 4);
+
+                if (l > kPdqNintherThreshold) {
+                    std::iter_swap(first + 1, first + (l / 4 + 1));
+                    std::iter_swap(first + 2, first + (l / 4 + 2));
+                    std::iter_swap(pivot - 2, pivot - (l / 4 + 1));
+                    std::iter_swap(pivot - 3, pivot - (l / 4 + 2));
+                }
+            }
+
+            if (r >= kPdqInsertionCutoff) {
+                std::iter_swap(pivot + 1, pivot + (1 + r / 4));
+                std::iter_swap(last - 1, last - r / 4);
+
+                if (r > kPdqNintherThreshold) {
+                    std::iter_swap(pivot + 2, pivot + (2 + r / 4));
+                    std::iter_swap(pivot + 3, pivot + (3 + r / 4));
+                    std::iter_swap(last - 2, last - (1 + r / 4));
+                    std::iter_swap(last - 3, last - (2 + r / 4));
+                }
+            }
+
+        } else if (already_partitioned
+                   && partial_insertion_sort(first, pivot, comp)
+                   && partial_insertion_sort(pivot + 1, last, comp))
+        {
+            return;
+        }
+
+        if (l < r) {
+            pdq_loop<Branchless>(first, pivot, bad_allowed, leftmost, comp);
+            first = pivot + 1;
+            leftmost = false;
+
+        } else {
+            pdq_loop<Branchless>(pivot + 1, last, bad_allowed, false, comp);
+            last = pivot;
+        }
+    }
+}
+
+
+/*
+ * 以 *first 为枢纽元划分，小于枢纽元的在左边，不小于的在右边，
+ * 返回枢纽元的位置以及划分前是否已经不需要交换
+ */
+template <typename RandomIt, typename Compare>
+std::pair<RandomIt, bool>
+QuickSorter::partition_right(RandomIt first, RandomIt last, Compare &comp)
+{
+    bool      already_partitioned;
+    RandomIt  i = first, j = last, pivot_pos;
+    auto      pivot = std::move(*first);
+
+    /* 三数取中保证右边存在不小于枢纽元的元素，左扫描不会越界 */
+    while (comp(*++i, pivot)) {  }
+
+    if (i - 1 == first) {
+        while (i < j && !comp(*--j, pivot)) {  }
+
+    } else {
+        while (!comp(*--j, pivot)) {  }
+    }
+
+    already_partitioned = i >= j;
+
+    while (i < j) {
+        std::iter_swap(i, j);
+        while (comp(*++i, pivot)) {  }
+        while (!comp(*--j, pivot)) {  }
+    }
+
+    pivot_pos = i - 1;
+    *first = std::move(*pivot_pos);
+    *pivot_pos = std::move(pivot);
+
+    return std::make_pair(pivot_pos, already_partitioned);
+}
+
+
+/*
+ * 与 partition_right 结果相同，但采用 BlockQuicksort (Edelkamp & Weiss,
+ * 2016) 的方式：先在左右两端各一块元素中记下位置放错的下标，
+ * 比较结果只参与加法而不参与跳转，然后成对交换
+ */
+template <typename RandomIt, typename Compare>
+std::pair<RandomIt, bool>
+QuickSorter::partition_right_branchless(RandomIt first, RandomIt last,
+    Compare &comp)
+{
+    bool           already_partitioned;
+    size_t         num_l, num_r, start_l, start_r, unknown, left_split,
+                   right_split, num, k;
+    RandomIt       i = first, j = last, base_l, base_r, pivot_pos;
+    auto           pivot = std::move(*first);
+    unsigned char  offsets_l[kPdqBlockSize], offsets_r[kPdqBlockSize];
+
+    while (comp(*++i, pivot)) {  }
+
+    if (i - 1 == first) {
+        while (i < j && !comp(*--j, pivot)) {  }
+
+    } else {
+        while (!comp(*--j, pivot)) {  }
+    }
+
+    already_partitioned = i >= j;
+
+    if (!already_partitioned) {
+        std::iter_swap(i, j);
+        i++;
+
+        base_l = i;
+        base_r = j;
+        num_l = num_r = start_l = start_r = 0;
+
+        while (i < j) {
+            /* 一端的下标用完了才继续扫描那一端，最后不足两块时对半分 */
+            unknown = j - i;
+            left_split = (num_l == 0)
+                         ? ((num_r == 0) ? unknown / 2 : unknown) : 0;
+            right_split = (num_r == 0) ? unknown - left_split : 0;
+
+            left_split = std::min<size_t>(left_split, kPdqBlockSize);
+            right_split = std::min<size_t>(right_split, kPdqBlockSize);
+
+            for (k = 0; k < left_split; k++) {
+                offsets_l[num_l] = static_cast<unsigned char>(k);
+                num_l += !comp(*i, pivot);
+                i++;
+            }
+
+            for (k = 0; k < right_split; k++) {
+                offsets_r[num_r] = static_cast<unsigned char>(k + 1);
+                num_r += comp(*--j, pivot);
+            }
+
+            num = std::min(num_l, num_r);
+            swap_offsets(base_l, base_r, offsets_l + start_l,
+                         offsets_r + start_r, num, num_l == num_r);
+
+            num_l -= num;
+            num_r -= num;
+            start_l += num;
+            start_r += num;
+
+            if (num_l == 0) {
+                start_l = 0;
+                base_l = i;
+            }
+
+            if (num_r == 0) {
+                start_r = 0;
+                base_r = j;
+            }
+        }
+
+        /* 剩下的只有一端有放错的元素，把它们逐个换到中间 */
+        if (num_l) {
+            while (num_l--) {
+                std::iter_swap(base_l + offsets_l[start_l + num_l], --j);
+            }
+
+            i = j;
+        }
+
+        if (num_r) {
+            while (num_r--) {
+                std::iter_swap(base_r - offsets_r[start_r + num_r], i);
+                i++;
+            }
+
+            j = i;
+        }
+    }
+
+    pivot_pos = i - 1;
+    *first = std::move(*pivot_pos);
+    *pivot_pos = std::move(pivot);
+
+    return std::make_pair(pivot_pos, already_partitioned);
+}
+
+
+/*
+ * 交换 first + offsets_l[i] 与 last - offsets_r[i]；两边个数不同时
+ * 用一条移动链代替逐对交换，每个元素只移动一次
+ */
+template <typename RandomIt>
+void
+QuickSorter::swap_offsets(RandomIt first, RandomIt last,
+    const unsigned char *offsets_l, const unsigned char *offsets_r,
+    size_t num, bool use_swaps)
+{
+    size_t    k;
+    RandomIt  l, r;
+
+    if (use_swaps) {
+        for (k = 0; k < num; k++) {
+            std::iter_swap(first + offsets_l[k], last - offsets_r[k]);
+        }
+
+        return;
+    }
+
+    if (num == 0) {
+        return;
+    }
+
+    l = first + offsets_l[0];
+    r = last - offsets_r[0];
+
+    auto  tmp = std::move(*l);
+    *l = std::move(*r);
+
+    for (k = 1; k < num; k++) {
+        l = first + offsets_l[k];
+        *r = std::move(*l);
+        r = last - offsets_r[k];
+        *l = std::move(*r);
+    }
+
+    *r = std::move(tmp);
+}
+
+
+/*
+ * 以 *first 为枢纽元划分，不大于枢纽元的在左边，大于的在右边，
+ * 调用者保证 *(first - 1) 等于枢纽元，它是右扫描的哨兵
+ */
+template <typename RandomIt, typename Compare>
+RandomIt
+QuickSorter::partition_left(RandomIt first, RandomIt last, Compare &comp)
+{
+    RandomIt  i = first, j = last, pivot_pos;
+    auto      pivot = std::move(*first);
+
+    while (comp(pivot, *--j)) {  }
+
+    if (j + 1 == last) {
+        while (i < j && !comp(pivot, *++i)) {  }
+
+    } else {
+        while (!comp(pivot, *++i)) {  }
+    }
+
+    while (i < j) {
+        std::iter_swap(i, j);
+        while (comp(pivot, *--j)) {  }
+        while (!comp(pivot, *++i)) {  }
+    }
+
+    pivot_pos = j;
+    *first = std::move(*pivot_pos);
+    *pivot_pos = std::move(pivot);
+
+    return pivot_pos;
+}
+
+
+/*
+ * *(first - 1) 不大于区间内的任何元素，内层循环不必检查边界
+ */
+template <typename RandomIt, typename Compare>
+void
+QuickSorter::unguarded_insertion_sort(RandomIt first, RandomIt last,
+    Compare &comp)
+{
+    RandomIt  i, j;
+
+    for (i = first + 1; i < last; i++) {
+        if (!comp(*i, *(i - 1))) {
+            continue;
+        }
+
+        auto  value = std::move(*i);
+
+        for (j = i; comp(value, *(j - 1)); j--) {
+            *j = std::move(*(j - 1));
+        }
+
+        *j = std::move(value);
+    }
+}
+
+
+/*
+ * 插入排序，但元素移动的总距离超过 kPdqPartialInsertionLimit 就放弃，
+ * 返回区间是否已经排好序
+ */
+template <typename RandomIt, typename Compare>
+bool
+QuickSorter::partial_insertion_sort(RandomIt first, RandomIt last,
+    Compare &comp)
+{
+    size_t    moved;
+    RandomIt  i, j;
+
+    if (first == last) {
+        return true;
+    }
+
+    moved = 0;
+
+    for (i = first + 1; i != last; i++) {
+        if (!comp(*i, *(i - 1))) {
+            continue;
+        }
+
+        auto  value = std::move(*i);
+
+        for (j = i; j != first && comp(value, *(j - 1)); j--) {
+            *j = std::move(*(j - 1));
+        }
+
+        *j = std::move(value);
+        moved += i - j;
+
+        if (moved > kPdqPartialInsertionLimit) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+template <typename RandomIt, typename Compare>
+void
+QuickSorter::sort3(RandomIt a, RandomIt b, RandomIt c, Compare &comp)
+{
+    if (comp(*b, *a)) {
+        std::iter_swap(a, b);
+    }
+
+    if (comp(*c, *b)) {
+        std::iter_swap(b, c);
+    }
+
+    if (comp(*b, *a)) {
+        std::iter_swap(a, b);
+    }
+}
+
+
+/*
+ * 划分出来的较小一半交给线程池，较大的一半在当前线程继续划分，
+ * 划分层数超过 depth_limit 之后整个区间顺序排序(kIntrosort 和 kPdq
+ * 保证 O(n log n))；返回之前等待交出去的任务，等待时执行别的任务
+ */
+template <typename RandomIt, typename Compare>
+void
+QuickSorter::parallel_sort(RandomIt first, RandomIt last, size_t depth_limit,
+    Compare comp) const
+{
+    TaskGroup  group;
+    RandomIt   lower, upper;
+
+    while (last - first > kParallelCutoff && depth_limit > 0) {
+        depth_limit--;
+
+        if (last - first > kParallelPartitionCutoff
+            && pool_->NumThreads() > 1)
+        {
+            parallel_split(first, last, &lower, &upper, comp);
+
+        } else {
+            split(first, last, &lower, &upper, comp);
+        }
+
+        if (lower - first < last - upper) {
+            pool_->Spawn(&group, [=] {
+                parallel_sort(first, lower, depth_limit, comp);
+            });
+
+            first = upper;
+
+        } else {
+            pool_->Spawn(&group, [=] {
+                parallel_sort(upper, last, depth_limit, comp);
+            });
+
+            last = lower;
+        }
+    }
+
+    sequential_sort(first, last, comp);
+    pool_->Wait(&group);
+}
+
+
+/*
+ * 在当前线程中划分，使用与 mode 相同的划分方法，[first, *lower) 不大于
+ * 枢纽元，[*upper, last) 不小于枢纽元，枢纽元及与它相等的元素在中间
+ */
+template <typename RandomIt, typename Compare>
+void
+QuickSorter::split(RandomIt first, RandomIt last, RandomIt *lower,
+    RandomIt *upper, Compare &comp) const
+{
+    typedef typename std::iterator_traits<RandomIt>::value_type  T;
+
+    ptrdiff_t  n = last - first, half = n / 2;
+
+    if (mode_ != kPdq) {
+        *lower = partition(first, last, comp);
+        *upper = *lower + 1;
+        return;
+    }
+
+    sort3(first, first + half, last - 1, comp);
+    sort3(first + 1, first + (half - 1), last - 2, comp);
+    sort3(first + 2, first + (half + 1), last - 3, comp);
+    sort3(first + (half - 1), first + half, first + (half + 1), comp);
+    std::iter_swap(first, first + half);
+
+    *lower = branchless<T, Compare>()
+             ? partition_right_branchless(first, last, comp).first
+             : partition_right(first, last, comp).first;
+    *upper = *lower + 1;
+
+    /* partition_right 把与枢纽元相等的元素都放在右边 */
+    if (*lower - first < n / 8) {
+        const T  &equal = **lower;
+
+        *upper = std::partition(*upper, last, [&](const T &value) {
+            return !comp(equal, value);
+        });
+    }
+}
+
+
+/*
+ * 以 ninther 为枢纽元并行划分，[first, *lower) 小于枢纽元，
+ * [*upper, last) 不小于枢纽元；小于枢纽元的元素很少时，可能是有大量
+ * 与枢纽元相等的元素，再把等于枢纽元的元素分出来，它们不再参与排序
+ */
+template <typename RandomIt, typename Compare>
+void
+QuickSorter::parallel_split(RandomIt first, RandomIt last, RandomIt *lower,
+    RandomIt *upper, Compare &comp) const
+{
+    typedef typename std::iterator_traits<RandomIt>::value_type  T;
+
+    RandomIt   middle;
+    ptrdiff_t  n = last - first, half = n / 2;
+
+    sort3(first, first + half, last - 1, comp);
+    sort3(first + 1, first + (half - 1), last - 2, comp);
+    sort3(first + 2, first + (half + 1), last - 3, comp);
+    sort3(first + (half - 1), first + half, first + (half + 1), comp);
+    std::iter_swap(first, first + half);
+
+    /* 划分 [first + 1, last) 时 *first 不会被移动，可以直接引用 */
+    const T  &pivot = *first;
+
+    middle = parallel_partition(first + 1, last, [&](const T &value) {
+        return comp(value, pivot);
+    });
+
+    std::iter_swap(first, middle - 1);
+    *lower = middle - 1;
+    *upper = middle;
+
+    if (*lower - first < n / 8) {
+        const T  &equal = **lower;
+
+        *upper = parallel_partition(middle, last, [&](const T &value) {
+            return !comp(equal, value);
+        });
+    }
+}
+
+
+/*
+ * 按 pred 并行划分 [first, last)，返回第一个不满足 pred 的位置：
+ *
+ *   1. 区间分为若干块，每块各自用 std::partition 划分
+ *   2. 满足 pred 的元素共 total 个，[0, total) 中不满足的和 [total, n)
+ *      中满足的元素位置放错了，两边个数相同
+ *   3. 把放错的元素按序号平均分给若干任务，第 k 个放错在左边的元素
+ *      与第 k 个放错在右边的元素交换
+ */
+template <typename RandomIt, typename Predicate>
+RandomIt
+QuickSorter::parallel_partition(RandomIt first, RandomIt last,
+    Predicate pred) const
+{
+    typedef std::pair<ptrdiff_t, ptrdiff_t>  Range;
+
+    size_t              c, nchunks, ntasks;
+    ptrdiff_t           n, total, wrong, b, e;
+    TaskGroup           group;
+    std::vector<Range>  wrong_l, wrong_r;
+
+    n = last - first;
+    nchunks = pool_->NumThreads() + 1;
+
+    std::vector<ptrdiff_t>  bounds(nchunks + 1), middles(nchunks);
+
+    for (c = 0; c <= nchunks; c++) {
+        bounds[c] = n * c / nchunks;
+    }
+
+    for (c = 0; c < nchunks; c++) {
+        pool_->Spawn(&group, [&, c] {
+            middles[c] = std::partition(first + bounds[c],
+                                        first + bounds[c + 1], pred) - first;
+        });
+    }
+
+    pool_->Wait(&group);
+
+    total = 0;
+    for (c = 0; c < nchunks; c++) {
+        total += middles[c] - bounds[c];
+    }
+
+    wrong = 0;
+    for (c = 0; c < nchunks; c++) {
+        b = middles[c];
+        e = std::min(bounds[c + 1], total);
+
+        if (b < e) {
+            wrong_l.push_back(Range(b, e));
+            wrong += e - b;
+        }
+
+        b = std::max(bounds[c], total);
+        e = middles[c];
+
+        if (b < e) {
+            wrong_r.push_back(Range(b, e));
+        }
+    }
+
+    /* 每个任务至少交换 kParallelCutoff 对元素 */
+    ntasks = std::min<size_t>(nchunks, wrong / kParallelCutoff + 1);
+
+    for (c = 0; c < ntasks; c++) {
+        pool_->Spawn(&group, [&, c] {
+            size_t     il = 0, ir = 0;
+            ptrdiff_t  k, l, r, end;
+
+            k = wrong * c / ntasks;
+            end = wrong * (c + 1) / ntasks;
+
+            if (k == end) {
+                return;
+            }
+
+            /* 找到第 k 个放错的元素所在的区间 */
+            l = k;
+            while (l >= wrong_l[il].second - wrong_l[il].first) {
+                l -= wrong_l[il].second - wrong_l[il].first;
+                il++;
+            }
+
+            r = k;
+            while (r >= wrong_r[ir].second - wrong_r[ir].first) {
+                r -= wrong_r[ir].second - wrong_r[ir].first;
+                ir++;
+            }
+
+            l += wrong_l[il].first;
+            r += wrong_r[ir].first;
+
+            for ( ; k < end; k++) {
+                std::iter_swap(first + l, first + r);
+
+                if (++l == wrong_l[il].second && ++il < wrong_l.size()) {
+                    l = wrong_l[il].first;
+                }
+
+                if (++r == wrong_r[ir].second && ++ir < wrong_r.size()) {
+                    r = wrong_r[ir].first;
+                }
+            }
+        });
+    }
+
+    pool_->Wait(&group);
+
+    return first + total;
+}
+
+
 #endif /* QUICK_SORT_H__ */
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#ifndef RADIX_SORT_H__
+#define RADIX_SORT_H__
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include <quick_sort.hh>
+#include <work_stealing_pool.hh>
+
+
+/*
+ * 整数的基数排序，需要 n 个元素的辅助空间
+ *
+ * LSD：32 位及以上的整数每趟处理 11 位(计数数组 16KB，能放进 L1)，
+ * 8 位和 16 位的整数每趟 8 位。一次读遍所有元素就得到每一趟的计数，
+ * 所有元素这一位都相同的趟直接跳过，所以取值范围较小的数据(比如
+ * gen-random.lua 生成的列)只需要很少的几趟；分发时预取后面元素的
+ * 目标位置
+ *
+ * 有符号整数把符号位取反之后按无符号整数排序，负数排在非负数之前
+ *
+ * 指定线程池并且元素超过 kParallelCutoff 个时使用 MSD：先找出最高的
+ * 不全相同的位，按它往下的 8 位并行地分到 256 个桶中，再把每个桶作为
+ * 一个任务，用 LSD 排序剩下的低位
+ */
+class RadixSorter
+{
+    public:
+        explicit RadixSorter(WorkStealingPool *pool = nullptr)
+            : pool_(pool) {}
+
+        template <typename T>
+        void Sort(T *first, T *last) const;
+
+        template <typename T>
+        void Sort(std::vector<T> &nums) const {
+            Sort(nums.data(), nums.data() + nums.size());
+        }
+
+    private:
+        /* 元素少时计数数组的开销不划算，改用 QuickSorter */
+        static const size_t    kRadixCutoff = 256;
+        static const size_t    kParallelCutoff = 1 << 20;
+        static const unsigned  kMsdBits = 8;
+        static const size_t    kPrefetchDistance = 16;
+
+        WorkStealingPool  *pool_;
+
+        template <typename T>
+        static typename std::make_unsigned<T>::type key(T value);
+
+        template <typename T>
+        static T *lsd_sort(T *src, T *dst, size_t n, unsigned bits);
+
+        template <typename T>
+        void msd_sort(T *first, T *buffer, size_t n) const;
+};
+
+
+template <typename T>
+void
+RadixSorter::Sort(T *first, T *last) const
+{
+    static_assert(std::is_integral<T>::value,
+                  "radix sort only supports integer keys");
+
+    T               *sorted;
+    const size_t     n = last - first;
+    std::vector<T>   buffer;
+
+    if (n < kRadixCutoff) {
+        QuickSorter(QuickSorter::kPdq).Sort(first, last);
+        return;
+    }
+
+    buffer.resize(n);
+
+    if (pool_ != nullptr && n > kParallelCutoff) {
+        msd_sort(first, buffer.data(), n);
+        return;
+    }
+
+    sorted = lsd_sort(first, buffer.data(), n, sizeof(T) * 8);
+
+    if (sorted != first) {
+        std::copy(sorted, sorted + n, first);
+    }
+}
+
+
+template <typename T>
+inline typename std::make_unsigned<T>::type
+RadixSorter::key(T value)
+{
+    typedef typename std::make_unsigned<T>::type  U;
+
+    if (std::is_signed<T>::value) {
+        return static_cast<U>(static_cast<U>(value)
+                              ^ (U(1) << (sizeof(T) * 8 - 1)));
+    }
+
+    return static_cast<U>(value);
+}
+
+
+/*
+ * 按低 bits 位对 src 排序，dst 为同样大小的辅助空间，两者交替使用，
+ * 返回排好序的数据所在的位置(src 或 dst)
+ */
+template <typename T>
+T *
+RadixSorter::lsd_sort(T *src, T *dst, size_t n, unsigned bits)
+{
+    typedef typename std::make_unsigned<T>::type  U;
+
+    const unsigned  width = (sizeof(T) >= 4) ? 11 : 8;
+    const size_t    radix = size_t(1) << width;
+    const U         mask = static_cast<U>(radix - 1);
+    const unsigned  passes = (bits + width - 1) / width;
+
+    size_t               i, d, sum, *count;
+    unsigned             p, shift;
+    std::vector<size_t>  counts(passes * radix, 0);
+
+    for (i = 0; i < n; i++) {
+        const U  k = key(src[i]);
+
+        for (p = 0; p < passes; p++) {
+            counts[p * radix + ((k >> (p * width)) & mask)]++;
+        }
+    }
+
+    for (p = 0; p < passes; p++) {
+        shift = p * width;
+        count = &counts[p * radix];
+
+        if (count[(key(src[0]) >> shift) & mask] == n) {
+            continue;
+        }
+
+        sum = 0;
+        for (d = 0; d < radix; d++) {
+            const size_t  c = count[d];
+
+            count[d] = sum;
+            sum += c;
+        }
+
+        for (i = 0; i < n; i++) {
+#if defined(__GNUC__)
+            if (i + kPrefetchDistance < n) {
+                __builtin_prefetch(&dst[count[(key(src[i + kPrefetchDistance])
+                                               >> shift) & mask]], 1);
+            }
+#endif
+
+            dst[count[(key(src[i]) >> shift) & mask]++] = src[i];
+        }
+
+        std::swap(src, dst);
+    }
+
+    return src;
+}
+
+
+/*
+ * 在 [first, first + n) 上并行 MSD 一趟，然后每个桶用 LSD 排序剩下的低位，
+ * buffer 为同样大小的辅助空间
+ */
+template <typename T>
+void
+RadixSorter::msd_sort(T *first, T *buffer, size_t n) const
+{
+    typedef typename std::make_unsigned<T>::type  U;
+
+    const size_t  radix = size_t(1) << kMsdBits;
+
+    size_t                  c, d, nchunks, sum;
+    unsigned                msb, shift;
+    uint64_t                diff;
+    TaskGroup               group;
+    std::vector<size_t>     bounds, starts(radix + 1);
+    std::vector<uint64_t>   diffs;
+    std::vector<size_t>     counts;
+    const U                 base = key(first[0]);
+
+    nchunks = pool_->NumThreads() + 1;
+    bounds.resize(nchunks + 1);
+    diffs.resize(nchunks);
+    counts.resize(nchunks * radix);
+
+    for (c = 0; c <= nchunks; c++) {
+        bounds[c] = n * c / nchunks;
+    }
+
+    /* 与第一个元素不同的位，它的最高位以上所有元素都相同 */
+    for (c = 0; c < nchunks; c++) {
+        pool_->Spawn(&group, [&, c] {
+            U  bits = 0;
+
+            for (size_t i = bounds[c]; i < bounds[c + 1]; i++) {
+                bits |= key(first[i]) ^ base;
+            }
+
+            diffs[c] = bits;
+        });
+    }
+
+    pool_->Wait(&group);
+
+    diff = 0;
+    for (c = 0; c < nchunks; c++) {
+        diff |= diffs[c];
+    }
+
+    if (diff == 0) {
+        return;
+    }
+
+    msb = 63 - __builtin_clzll(diff);
+    shift = (msb + 1 > kMsdBits) ? msb + 1 - kMsdBits : 0;
+
+    for (c = 0; c < nchunks; c++) {
+        pool_->Spawn(&group, [&, c] {
+            size_t  *count = &counts[c * radix];
+
+            for (size_t i = bounds[c]; i < bounds[c + 1]; i++) {
+                count[(key(first[i]) >> shift) & (radix - 1)]++;
+            }
+        });
+    }
+
+    pool_->Wait(&group);
+
+    /* 桶 d 中第 c 块的元素从 counts[c * radix + d] 开始存放 */
+    sum = 0;
+    for (d = 0; d < radix; d++) {
+        starts[d] = sum;
+
+        for (c = 0; c < nchunks; c++) {
+            const size_t  count = counts[c * radix + d];
+
+            counts[c * radix + d] = sum;
+            sum += count;
+        }
+    }
+
+    starts[radix] = n;
+
+    for (c = 0; c < nchunks; c++) {
+        pool_->Spawn(&group, [&, c] {
+            size_t  *offset = &counts[c * radix];
+
+            for (size_t i = bounds[c]; i < bounds[c + 1]; i++) {
+                buffer[offset[(key(first[i]) >> shift) & (radix - 1)]++]
+                    = first[i];
+            }
+        });
+    }
+
+    pool_->Wait(&group);
+
+    for (d = 0; d < radix; d++) {
+        if (starts[d] == starts[d + 1]) {
+            continue;
+        }
+
+        pool_->Spawn(&group, [&, d] {
+            T       *src = buffer + starts[d], *dst = first + starts[d];
+            size_t   m = starts[d + 1] - starts[d];
+
+            if (shift == 0) {
+                std::copy(src, src + m, dst);
+                return;
+            }
+
+            if (m < kRadixCutoff) {
+                std::copy(src, src + m, dst);
+                QuickSorter(QuickSorter::kPdq).Sort(dst, dst + m);
+                return;
+            }
+
+            src = lsd_sort(src, dst, m, shift);
+
+            if (src != dst) {
+                std::copy(src, src + m, dst);
+            }
+        });
+    }
+
+    pool_->Wait(&group);
+}
+
+
+#endif /* RADIX_SORT_H__ */
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#ifndef SCALABLE_BLOOM_FILTER_H__
+#define SCALABLE_BLOOM_FILTER_H__
+
+
+#include <bloom_filter.hh>
+
+
+/*
+ * Scalable Bloom Filter (Almeida et al., 2007)
+ *
+ * 由一串固定大小的子过滤器组成，当前子过滤器装满后追加一个新的，
+ * 新子过滤器的容量乘以 growth，误判率乘以 tightening。第一个子过滤器的
+ * 误判率为 fp_rate * (1 - tightening)，所以总的误判率不超过 fp_rate，
+ * 扩大时不需要保存 key
+ */
+class ScalableBloomFilter
+{
+    public:
+        explicit ScalableBloomFilter(double fp_rate,
+                                     size_t initial_capacity = 1024,
+                                     BloomFilter::Layout layout
+                                         = BloomFilter::kStandard,
+                                     size_t growth = 2,
+                                     double tightening = 0.5);
+
+        void AddKey(const std::string &key);
+        bool KeyMayMatch(const std::string &key) const;
+
+        size_t NumKeys() const { return num_keys_; }
+        size_t NumFilters() const { return filters_.size(); }
+        size_t ApproximateMemoryUsage() const;
+
+    private:
+        double                    fp_rate_;
+        size_t                    capacity_;
+        BloomFilter::Layout       layout_;
+        size_t                    growth_;
+        double                    tightening_;
+        size_t                    num_keys_;
+        /* 当前子过滤器中 key 的个数 */
+        size_t                    filled_;
+        std::vector<BloomFilter>  filters_;
+
+        void AddFilter();
+};
+
+
+#endif /* SCALABLE_BLOOM_FILTER_H__ */
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#ifndef SHARDED_BLOOM_FILTER_H__
+#define SHARDED_BLOOM_FILTER_H__
+
+
+#include <memory>
+#include <shared_mutex>
+#include <bloom_filter.hh>
+
+
+/*
+ * 由 N 个独立的 BloomFilter 组成，按 BloomHash 的高位把 key 分到各个分片。
+ * 每个分片有自己的读写锁，扩大位图时只需要重新设置这个分片的 key，
+ * 也只阻塞访问这个分片的查询，其他分片不受影响。选择分片的 hash 直接
+ * 交给分片，每个 key 只计算一次 hash，分片也只保存 hash 而不保存 key
+ */
+class ShardedBloomFilter
+{
+    public:
+        /* nshards 会向上取整为 2 的幂 */
+        explicit ShardedBloomFilter(int bits_per_key, size_t nshards = 16,
+                                    BloomFilter::Layout layout
+                                        = BloomFilter::kStandard);
+
+        /* 可以被多个线程同时调用 */
+        void AddKey(const std::string &key);
+        bool KeyMayMatch(const std::string &key) const;
+
+        size_t NumShards() const { return nshards_; }
+        size_t NumKeys() const;
+        size_t ApproximateMemoryUsage() const;
+
+    private:
+        struct Shard {
+            mutable std::shared_timed_mutex  lock;
+            BloomFilter                      filter;
+
+            Shard(int bits_per_key, BloomFilter::Layout layout)
+                : filter(bits_per_key, layout) {}
+        };
+
+        size_t                                nshards_;
+        unsigned                              shift_;
+        std::vector<std::unique_ptr<Shard>>   shards_;
+
+        Shard &ShardFor(uint32_t h) const {
+            return *shards_[shift_ < 32 ? h >> shift_ : 0];
+        }
+};
+
+
+#endif /* SHARDED_BLOOM_FILTER_H__ */
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#ifndef SLICE_H__
+#define SLICE_H__
+
+
+#include <string.h>
+#include <string>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+
+/*
+ * 指向一段外部内存的只读视图，不拥有也不拷贝数据，
+ * 调用者要保证使用期间数据一直有效。std::string、C 字符串
+ * 以及 (指针, 长度) 都可以隐式转换为 Slice，在网络缓冲区或者
+ * mmap 的记录中直接 hash 或查询 key，不需要先构造 std::string
+ */
+class Slice
+{
+    public:
+        constexpr Slice() : data_(""), size_(0) {}
+        constexpr Slice(const char *data, size_t size)
+            : data_(data), size_(size) {}
+
+        /* 字符串字面量的长度可以在编译期算出 */
+        constexpr Slice(const char *s) : data_(s), size_(Length(s)) {}
+        Slice(const std::string &s) : data_(s.data()), size_(s.size()) {}
+
+#if __cplusplus >= 201703L
+        Slice(std::string_view s) : data_(s.data()), size_(s.size()) {}
+#endif
+
+        constexpr const char *data() const { return data_; }
+        constexpr size_t size() const { return size_; }
+        constexpr bool empty() const { return size_ == 0; }
+
+        constexpr char operator[](size_t n) const { return data_[n]; }
+
+        std::string ToString() const { return std::string(data_, size_); }
+
+        bool starts_with(const Slice &x) const {
+            return size_ >= x.size_ && memcmp(data_, x.data_, x.size_) == 0;
+        }
+
+        int compare(const Slice &x) const {
+            const size_t  n = (size_ < x.size_) ? size_ : x.size_;
+            int           r = memcmp(data_, x.data_, n);
+
+            if (r == 0) {
+                r = (size_ < x.size_) ? -1 : (size_ > x.size_);
+            }
+
+            return r;
+        }
+
+    private:
+        const char  *data_;
+        size_t       size_;
+
+        static constexpr size_t Length(const char *s) {
+#if defined(__GNUC__)
+            return __builtin_strlen(s);
+#else
+            size_t  n = 0;
+
+            while (s[n] != '\0') {
+                n++;
+            }
+
+            return n;
+#endif
+        }
+};
+
+
+inline bool operator==(const Slice &x, const Slice &y)
+{
+    return x.size() == y.size() && memcmp(x.data(), y.data(), x.size()) == 0;
+}
+
+
+inline bool operator!=(const Slice &x, const Slice &y)
+{
+    return !(x == y);
+}
+
+
+#endif /* SLICE_H__ */
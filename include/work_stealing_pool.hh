@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+#ifndef WORK_STEALING_POOL_H__
+#define WORK_STEALING_POOL_H__
+
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/*
+ * 一组通过 WorkStealingPool::Spawn 提交的任务，Wait 等待它们全部完成
+ */
+class TaskGroup
+{
+    public:
+        TaskGroup() : pending_(0) {}
+
+    private:
+        friend class WorkStealingPool;
+
+        std::atomic<size_t>  pending_;
+};
+
+
+/*
+ * 用于 fork-join 式并行的线程池。每个工作线程有自己的任务队列，
+ * 从队尾压入和取出(后提交的任务数据还在 cache 里)，自己的队列空了
+ * 就从别的队列头部偷取(先提交的任务通常更大)；池外线程提交的任务
+ * 放在一个公共队列中
+ *
+ * Wait 一边等待一边执行队列里的任务，所以任务中可以继续 Spawn 和 Wait，
+ * 递归的分治算法不会因为线程都在等待而死锁；没有任务可做时先自旋
+ * kWaitSpins 次，之后在条件变量上睡眠，直到有新任务或者组内任务完成
+ *
+ * 只有头文件，只用 QuickSorter 串行排序的程序不需要额外链接
+ */
+class WorkStealingPool
+{
+    public:
+        /* nthreads 为 0 时使用 CPU 的个数 */
+        explicit WorkStealingPool(size_t nthreads = 0);
+        ~WorkStealingPool();
+
+        WorkStealingPool(const WorkStealingPool &) = delete;
+        WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+        size_t NumThreads() const { return threads_.size(); }
+
+        /* 可以被任意线程调用，包括池中正在执行任务的线程 */
+        void Spawn(TaskGroup *group, std::function<void()> task);
+        void Wait(TaskGroup *group);
+
+    private:
+        struct Task {
+            std::function<void()>  fn;
+            TaskGroup             *group;
+        };
+
+        struct Queue {
+            std::mutex         mutex;
+            std::deque<Task>   tasks;
+        };
+
+        /* 当前线程所属的线程池以及它在池中的编号 */
+        struct Current {
+            const WorkStealingPool  *pool;
+            size_t                   index;
+        };
+
+        static const int  kWaitSpins = 64;
+
+        /* 最后一个是池外线程共用的队列 */
+        std::vector<std::unique_ptr<Queue>>  queues_;
+        std::vector<std::thread>             threads_;
+        std::atomic<size_t>                  queued_;
+        std::mutex                           mutex_;
+        std::condition_variable              cond_;
+        bool                                 stop_;
+
+        static Current &current();
+
+        size_t Self() const;
+        bool Pop(size_t self, Task *task);
+        void Execute(Task *task);
+        void Loop(size_t self);
+};
+
+
+inline
+WorkStealingPool::WorkStealingPool(size_t nthreads)
+    : queued_(0), stop_(false)
+{
+    if (nthreads == 0) {
+        nthreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i <= nthreads; i++) {
+        queues_.emplace_back(new Queue());
+    }
+
+    for (size_t i = 0; i < nthreads; i++) {
+        threads_.emplace_back(&WorkStealingPool::Loop, this, i);
+    }
+}
+
+
+inline
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex>  guard(mutex_);
+
+        stop_ = true;
+    }
+
+    cond_.notify_all();
+
+    for (auto &thread : threads_) {
+        thread.join();
+    }
+}
+
+
+inline void
+WorkStealingPool::Spawn(TaskGroup *group, std::function<void()> task)
+{
+    Queue  &queue = *queues_[Self()];
+
+    group->pending_.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex>  guard(queue.mutex);
+
+        queue.tasks.push_back(Task{ std::move(task), group });
+    }
+
+    /* 先增加计数再加锁通知，空闲线程在 mutex_ 下检查计数，不会错过唤醒 */
+    queued_.fetch_add(1, std::memory_order_release);
+
+    {
+        std::lock_guard<std::mutex>  guard(mutex_);
+    }
+
+    cond_.notify_one();
+}
+
+
+inline void
+WorkStealingPool::Wait(TaskGroup *group)
+{
+    Task          task;
+    int           spins = 0;
+    const size_t  self = Self();
+
+    while (group->pending_.load(std::memory_order_acquire) != 0) {
+        if (Pop(self, &task)) {
+            Execute(&task);
+            spins = 0;
+            continue;
+        }
+
+        if (++spins < kWaitSpins) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        /* Execute 和 Spawn 都在 mutex_ 下通知，检查条件之后不会错过唤醒 */
+        std::unique_lock<std::mutex>  lock(mutex_);
+
+        cond_.wait(lock, [this, group] {
+            return group->pending_.load(std::memory_order_acquire) == 0
+                   || queued_.load(std::memory_order_acquire) > 0;
+        });
+
+        /* 可能消耗了 Spawn 发给工作线程的唤醒，自己不执行的话要转交 */
+        if (group->pending_.load(std::memory_order_acquire) == 0
+            && queued_.load(std::memory_order_acquire) > 0)
+        {
+            lock.unlock();
+            cond_.notify_one();
+            return;
+        }
+
+        spins = 0;
+    }
+}
+
+
+inline WorkStealingPool::Current &
+WorkStealingPool::current()
+{
+    static thread_local Current  cur = { nullptr, 0 };
+
+    return cur;
+}
+
+
+inline size_t
+WorkStealingPool::Self() const
+{
+    const Current  &cur = current();
+
+    return (cur.pool == this) ? cur.index : queues_.size() - 1;
+}
+
+
+/*
+ * 先从自己队列的尾部取，再依次从其他队列的头部偷
+ */
+inline bool
+WorkStealingPool::Pop(size_t self, Task *task)
+{
+    size_t  i, victim;
+
+    if (queued_.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+
+    for (i = 0; i < queues_.size(); i++) {
+        victim = (self + i) % queues_.size();
+
+        Queue                        &queue = *queues_[victim];
+        std::lock_guard<std::mutex>   guard(queue.mutex);
+
+        if (queue.tasks.empty()) {
+            continue;
+        }
+
+        if (i == 0) {
+            *task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+
+        } else {
+            *task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    return false;
+}
+
+
+inline void
+WorkStealingPool::Execute(Task *task)
+{
+    task->fn();
+    task->fn = nullptr;
+
+    if (task->group->pending_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    /* 组内最后一个任务，唤醒可能在 Wait 中睡眠的线程 */
+    {
+        std::lock_guard<std::mutex>  guard(mutex_);
+    }
+
+    cond_.notify_all();
+}
+
+
+inline void
+WorkStealingPool::Loop(size_t self)
+{
+    Task  task;
+
+    current().pool = this;
+    current().index = self;
+
+    for ( ;; ) {
+        if (Pop(self, &task)) {
+            Execute(&task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex>  lock(mutex_);
+
+        cond_.wait(lock, [this] {
+            return stop_ || queued_.load(std::memory_order_acquire) > 0;
+        });
+
+        if (stop_ && queued_.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+
+#endif /* WORK_STEALING_POOL_H__ */
@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <quick_sort.hh>
+#include <bench_timer.hh>
+
+
+struct Record {
+    uint64_t  key;
+    uint64_t  value;
+};
+
+static_assert(sizeof(Record) == 16, "record must be 16 bytes");
+
+
+template <typename T, typename Compare>
+static void bench(const char *name, const std::vector<T> &input,
+    Compare comp);
+template <typename T, typename Compare>
+static void bench_parallel(const char *name, const std::vector<T> &input,
+    Compare comp, WorkStealingPool *pool);
+template <typename T, typename Compare>
+static double run(const QuickSorter *sorter, const std::vector<T> &input,
+    Compare comp, std::vector<T> *out);
+static std::vector<int> make_killer(size_t n);
+
+
+/*
+ * 在随机输入上比较 QuickSorter 与 std::sort，元素类型分别为 int、
+ * uint64_t 和 16 字节的记录(按 key 排序)；然后在有序、逆序和 organ-pipe
+ * 等特殊的 int 输入上比较(最多 1000000 个元素)；其中 killer 是专门针对
+ * kClassic 构造的输入，会使它退化到 O(n^2)，所以只排 100000 个元素；
+ * 最后比较使用 nthreads 个线程(默认为 CPU 个数)的并行排序
+ *
+ * usage: quick_sort_bench [n] [nthreads]
+ */
+int
+main(int argc, char **argv)
+{
+    size_t                 n, m, i;
+    std::mt19937_64        rng(20240601);
+    std::vector<int>       ints, sorted, reversed, organ_pipe, sawtooth,
+                           nearly_sorted, few_unique;
+    std::vector<uint64_t>  u64s;
+    std::vector<Record>    records;
+
+    n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000000;
+
+    WorkStealingPool  pool((argc > 2) ? strtoul(argv[2], NULL, 10) : 0);
+
+    for (i = 0; i < n; i++) {
+        ints.push_back(static_cast<int>(rng()));
+        u64s.push_back(rng());
+        records.push_back(Record{ rng(), i });
+    }
+
+    printf("%-12s %10s %10s %10s %10s %10s\n", "input", "n", "classic",
+           "introsort", "pdq", "std::sort");
+
+    bench("int", ints, std::less<int>());
+    bench("uint64_t", u64s, std::less<uint64_t>());
+    bench("record", records, [](const Record &a, const Record &b) {
+        return a.key < b.key;
+    });
+
+    m = std::min<size_t>(n, 1000000);
+
+    for (i = 0; i < m; i++) {
+        sorted.push_back(i);
+        reversed.push_back(m - i);
+        organ_pipe.push_back(i < m / 2 ? i : m - i);
+        sawtooth.push_back(i % 1000);
+        few_unique.push_back(rng() % 16);
+    }
+
+    // 每 1000 个元素中有一个放错位置
+    nearly_sorted = sorted;
+    for (i = 0; i < m / 1000; i++) {
+        nearly_sorted[rng() % m] = rng() % m;
+    }
+
+    bench("sorted", sorted, std::less<int>());
+    bench("reversed", reversed, std::less<int>());
+    bench("organ-pipe", organ_pipe, std::less<int>());
+    bench("sawtooth", sawtooth, std::less<int>());
+    bench("nearly-sort", nearly_sorted, std::less<int>());
+    bench("few-unique", few_unique, std::less<int>());
+    bench("killer", make_killer(std::min<size_t>(m, 100000)),
+          std::less<int>());
+
+    printf("\n%-12s %10s %10s %10s %10s %10s\n", "input", "n", "threads",
+           "introsort", "pdq", "std::sort");
+
+    bench_parallel("int", ints, std::less<int>(), &pool);
+    bench_parallel("uint64_t", u64s, std::less<uint64_t>(), &pool);
+    bench_parallel("record", records, [](const Record &a, const Record &b) {
+        return a.key < b.key;
+    }, &pool);
+    bench_parallel("few-unique", few_unique, std::less<int>(), &pool);
+
+    return 0;
+}
+
+
+/*
+ * 耗时单位为毫秒，各种排序的结果必须与 std::sort 一致
+ */
+template <typename T, typename Compare>
+static void
+bench(const char *name, const std::vector<T> &input, Compare comp)
+{
+    double             ms[4];
+    std::vector<T>     out[4];
+    const QuickSorter  classic(QuickSorter::kClassic);
+    const QuickSorter  introsort(QuickSorter::kIntrosort);
+    const QuickSorter  pdq(QuickSorter::kPdq);
+
+    ms[0] = run(&classic, input, comp, &out[0]);
+    ms[1] = run(&introsort, input, comp, &out[1]);
+    ms[2] = run(&pdq, input, comp, &out[2]);
+    ms[3] = run<T>(NULL, input, comp, &out[3]);
+
+    for (int k = 0; k < 3; k++) {
+        for (size_t i = 0; i < input.size(); i++) {
+            if (comp(out[k][i], out[3][i]) || comp(out[3][i], out[k][i])) {
+                fprintf(stderr, "%s: mismatch at %zu\n", name, i);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    printf("%-12s %10zu %10.1f %10.1f %10.1f %10.1f\n", name, input.size(),
+           ms[0], ms[1], ms[2], ms[3]);
+}
+
+
+/*
+ * introsort 和 pdq 使用线程池并行排序，std::sort 为单线程
+ */
+template <typename T, typename Compare>
+static void
+bench_parallel(const char *name, const std::vector<T> &input, Compare comp,
+    WorkStealingPool *pool)
+{
+    double             ms[3];
+    std::vector<T>     out[3];
+    const QuickSorter  introsort(QuickSorter::kIntrosort, pool);
+    const QuickSorter  pdq(QuickSorter::kPdq, pool);
+
+    ms[0] = run(&introsort, input, comp, &out[0]);
+    ms[1] = run(&pdq, input, comp, &out[1]);
+    ms[2] = run<T>(NULL, input, comp, &out[2]);
+
+    for (int k = 0; k < 2; k++) {
+        for (size_t i = 0; i < input.size(); i++) {
+            if (comp(out[k][i], out[2][i]) || comp(out[2][i], out[k][i])) {
+                fprintf(stderr, "%s: parallel mismatch at %zu\n", name, i);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    printf("%-12s %10zu %10zu %10.1f %10.1f %10.1f\n", name, input.size(),
+           pool->NumThreads(), ms[0], ms[1], ms[2]);
+}
+
+
+/*
+ * sorter 为 NULL 时使用 std::sort
+ */
+template <typename T, typename Compare>
+static double
+run(const QuickSorter *sorter, const std::vector<T> &input, Compare comp,
+    std::vector<T> *out)
+{
+    *out = input;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (sorter != NULL) {
+        sorter->Sort(out->begin(), out->end(), comp);
+
+    } else {
+        std::sort(out->begin(), out->end(), comp);
+    }
+
+    return elapsed_ms(start);
+}
+
+
+/*
+ * McIlroy 的 antiqsort：元素的值在比较时才确定，未确定的值(gas)都比已
+ * 确定的大；两个 gas 比较时把当前的候选枢纽元确定下来，使每次划分都
+ * 极不均匀。用 kClassic 排序一遍之后，val 就是针对它的最坏输入
+ */
+static std::vector<int>
+make_killer(size_t n)
+{
+    int               gas, nsolid, candidate;
+    std::vector<int>  val(n), ptr(n);
+
+    gas = n;
+    nsolid = 0;
+    candidate = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        val[i] = gas;
+        ptr[i] = i;
+    }
+
+    QuickSorter(QuickSorter::kClassic).Sort(ptr.begin(), ptr.end(),
+        [&](int x, int y) {
+            if (val[x] == gas && val[y] == gas) {
+                val[x == candidate ? x : y] = nsolid++;
+            }
+
+            if (val[x] == gas) {
+                candidate = x;
+
+            } else if (val[y] == gas) {
+                candidate = y;
+            }
+
+            return val[x] < val[y];
+        });
+
+    return val;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) Jianyong Chen
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <quick_sort.hh>
+#include <radix_sort.hh>
+#include <bench_timer.hh>
+
+
+template <typename T>
+static void bench(const char *name, const std::vector<T> &input,
+    WorkStealingPool *pool);
+
+
+/*
+ * 比较 RadixSorter(LSD 和使用线程池的并行 MSD)、QuickSorter(kPdq)与
+ * std::sort。column1 和 column2 与 utils/scripts/gen-random.lua 生成的
+ * 两列取值范围相同，分别为 [1, 100000] 和 [1, 100]
+ *
+ * usage: radix_sort_bench [n] [nthreads]
+ */
+int
+main(int argc, char **argv)
+{
+    size_t                 n, i;
+    std::mt19937_64        rng(20240601);
+    std::vector<int32_t>   i32s, column1, column2;
+    std::vector<int64_t>   i64s;
+    std::vector<uint64_t>  u64s;
+
+    n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000000;
+
+    WorkStealingPool  pool((argc > 2) ? strtoul(argv[2], NULL, 10) : 0);
+
+    for (i = 0; i < n; i++) {
+        i32s.push_back(static_cast<int32_t>(rng()));
+        column1.push_back(rng() % 100000 + 1);
+        column2.push_back(rng() % 100 + 1);
+        i64s.push_back(static_cast<int64_t>(rng()));
+        u64s.push_back(rng());
+    }
+
+    printf("%-10s %10s %10s %10s %10s %10s\n", "input", "n", "lsd",
+           "msd", "pdq", "std::sort");
+
+    bench("int32", i32s, &pool);
+    bench("column1", column1, &pool);
+    bench("column2", column2, &pool);
+    bench("int64", i64s, &pool);
+    bench("uint64", u64s, &pool);
+
+    printf("msd uses %zu threads\n", pool.NumThreads());
+
+    return 0;
+}
+
+
+/*
+ * 耗时单位为毫秒，各种排序的结果必须与 std::sort 一致
+ */
+template <typename T>
+static void
+bench(const char *name, const std::vector<T> &input, WorkStealingPool *pool)
+{
+    double          ms[4];
+    std::vector<T>  out[4];
+
+    for (int k = 0; k < 4; k++) {
+        out[k] = input;
+
+        auto start = std::chrono::steady_clock::now();
+
+        switch (k) {
+        case 0:
+            RadixSorter().Sort(out[k]);
+            break;
+
+        case 1:
+            RadixSorter(pool).Sort(out[k]);
+            break;
+
+        case 2:
+            QuickSorter(QuickSorter::kPdq).Sort(out[k].begin(), out[k].end());
+            break;
+
+        default:
+            std::sort(out[k].begin(), out[k].end());
+            break;
+        }
+
+        ms[k] = elapsed_ms(start);
+    }
+
+    for (int k = 0; k < 3; k++) {
+        if (out[k] != out[3]) {
+            fprintf(stderr, "%s: result %d differs from std::sort\n", name, k);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    printf("%-10s %10zu %10.1f %10.1f %10.1f %10.1f\n", name, input.size(),
+           ms[0], ms[1], ms[2], ms[3]);
+}